@@ -32,8 +32,9 @@
 #include "back.h"
 #include "cpu.h"
 
-int memory[MEMORY_MAX] = { 0 };   /* 64K of program memory                   */
-int pc = 0;                       /* location of next instr to be assembled  */
+uint8_t memory[MEMORY_MAX] = { 0 }; /* 64K of program memory                   */
+int pc = 0;                         /* location of next instr to be assembled  */
+char instr_start[MEMORY_MAX];       /* TRUE where an instruction was assembled */
 
 /* writeListLine will a print a line of the assembly listing consisting
  * of the line number, address, opcodes, and the original line of assembly.
@@ -187,6 +188,8 @@ void loadMemory(const int *theInstr, int *tkn)
 {
   int n, t, tkn_pos = 0;
 
+  if (theInstr[INSTR_TKN_OP] != UNDEF) instr_start[pc] = TRUE;
+
   /* Any instruction unique to a paticular processor are handled by 
    * handle instr
    */
@@ -35,6 +35,7 @@
 #include "asm.h"
 #include "err.h"
 #include "cpu.h"
+#include "sim.h"
 
 /* legal characters for labels
  */
@@ -356,6 +357,99 @@ static int findBinaryOp(str_storage expr)
   return pos;
 }
 
+/* operators of compiled expressions. x_add and following are binary
+ */
+enum expr_op
+  {
+    x_const, x_reg, x_ref, x_mem, x_neg, x_not, x_inv,
+    x_add, x_sub, x_mul, x_and, x_or, x_xor, x_div, x_mod,
+    x_shr, x_gt, x_shl, x_lt, x_ge, x_le, x_ne, x_eq
+  };
+
+/* binaryOp returns the binary operator found at expr[pos]. pos is at
+ * the second char of 2 char operators
+ */
+static int binaryOp(str_storage expr, int pos)
+{
+  switch (expr[pos])
+    {
+    case '+': return x_add;
+    case '-': return x_sub;
+    case '*': return x_mul;
+    case '&': return x_and;
+    case '|': return x_or;
+    case '^': return x_xor;
+    case '/': return x_div;
+    case '%': return x_mod;
+    case '>': return (expr[pos + 1] == '>') ? x_shr : x_gt;
+    case '<': return (expr[pos + 1] == '<') ? x_shl : x_lt;
+    case '=':
+      switch (expr[pos - 1])
+	{
+	case '>':  return x_ge;
+	case '<':  return x_le;
+	case '!':  return x_ne;
+	case '=':  return x_eq;
+	}
+      break;
+    }
+  longjmp(*exprErr, no_op); /* unknown operator???? */
+}
+
+/* return value of lvalue op rvalue
+ */
+static int binaryValue(int op, int lvalue, int rvalue)
+{
+  switch (op)
+    {
+    case x_add: return lvalue + rvalue;
+    case x_sub: return lvalue - rvalue;
+    case x_mul: return lvalue * rvalue;
+    case x_and: return lvalue & rvalue;
+    case x_or:  return lvalue | rvalue;
+    case x_xor: return lvalue ^ rvalue;
+    case x_div:
+      if (!rvalue) longjmp(*exprErr, zero_div);
+      return lvalue / rvalue;
+    case x_mod: return (rvalue) ? lvalue % rvalue : 0;
+    case x_shr: return lvalue >> rvalue;
+    case x_gt:  return lvalue > rvalue;
+    case x_shl: return lvalue << rvalue;
+    case x_lt:  return lvalue < rvalue;
+    case x_ge:  return lvalue >= rvalue;
+    case x_le:  return lvalue <= rvalue;
+    case x_ne:  return lvalue != rvalue;
+    default:    return lvalue == rvalue;
+    }
+}
+
+/* unaryOp returns the unary operator of char op, x_const for '+'
+ */
+static int unaryOp(char op)
+{
+  switch (op)
+    {
+    case '+': return x_const;
+    case '-': return x_neg;
+    case '!': return x_not;
+    case '~': return x_inv;
+    }
+  longjmp(*exprErr, no_op); /* unknown opeator???? */
+}
+
+/* return value of unary op applied to value
+ */
+static int unaryValue(int op, int value)
+{
+  switch (op)
+    {
+    case x_neg: return -value;
+    case x_not: return !value;
+    case x_inv: return ~value;
+    default:    return value;
+    }
+}
+
 /* getExpr returns the value of the expression given it. All labels should
  * exists with defined values. Division by zero will generate fatal error.
  * okay to change expr as long as you undo it before you undo it
@@ -404,44 +498,7 @@ int getExpr(char *expr)
       if ((expr[start + pos] == expr[start + pos + 1]) || 
 	  (expr[start + pos + 1] == '=')) ++pos;
       rvalue = getExpr(expr + start + pos + 1);
-      
-      switch (expr[pos])
-	{
-	case '+': value = lvalue + rvalue; break;
-	case '-': value = lvalue - rvalue; break;
-	case '*': value = lvalue * rvalue; break;
-	case '&': value = lvalue & rvalue; break;
-	case '|': value = lvalue | rvalue; break;
-	case '^': value = lvalue ^ rvalue; break;
-	case '/': 
-	  if (!rvalue) longjmp(*exprErr, zero_div);
-	  value = lvalue / rvalue;
-	  break;
-	case '%':
-	  value = (rvalue) ? lvalue % rvalue : 0;
-	  break;      
-	case '>': 
-	  value = (expr[pos + 1] == '>') ? lvalue >> rvalue : lvalue > rvalue;
-	  break;
-	case '<':
-	  value = (expr[pos + 1] == '<') ? lvalue << rvalue : lvalue < rvalue;
-	  break;
-	case '=':
-	  switch (expr[pos - 1])
-	    {
-	    case '>':  value = lvalue >= rvalue; break;
-	    case '<':  value = lvalue <= rvalue; break;
-	    case '!':  value = lvalue != rvalue; break;
-	    case '=':  value = lvalue == rvalue; break;
-	    default: 
-	      longjmp(*exprErr, no_op); /* unknown operator???? */
-	      break;
-	}
-	  break;
-	default: 
-	  longjmp(*exprErr, no_op); /* unknown operator???? */
-	  break;
-	}
+      value = binaryValue(binaryOp(expr, pos), lvalue, rvalue);
       return value; /* no more processing needed */
     }
   else
@@ -468,20 +525,214 @@ int getExpr(char *expr)
 	}
     }
   
-  while (start--)
+  while (start--) value = unaryValue(unaryOp(expr[start]), value);
+  return value;
+}
+
+static void compileExpr_r(char*);
+
+static expr_code *comp = NULL; /* expression being compiled */
+static char *comp_str = NULL;   /* copy of compiled string  */
+
+/* add instruction to compiled expression and keep track of stack depth
+ */
+static void emitExpr(int op, int value, int *ptr, char *ref)
+{
+  expr_instr *ip;
+
+  if (comp->num >= comp->size) safeRealloc(comp->code, expr_instr, comp->size += 8);
+  ip = comp->code + comp->num++;
+  ip->op = op; ip->value = value; ip->ptr = ptr; ip->ref = ref;
+
+  if (op<x_mem && ++comp->depth>comp->max) comp->max = comp->depth;
+  else if (op>=x_add) --comp->depth;
+}
+
+/* return TRUE if the last n instructions are constants
+ */
+#define lastConst(n) (comp->num>=(n) && comp->code[comp->num - 1].op==x_const && \
+		      ((n)==1 || comp->code[comp->num - 2].op==x_const))
+
+/* emit binary operator op, fold it if both operands are constants
+ */
+static void emitBinary(int op)
+{
+  if (lastConst(2))
+    {
+      comp->num -= 2; comp->depth -= 2;
+      emitExpr(x_const, binaryValue(op, comp->code[comp->num].value,
+				    comp->code[comp->num + 1].value), NULL, NULL);
+    }
+  else emitExpr(op, 0, NULL, NULL);
+}
+
+/* emit unary operator op, fold it if the operand is a constant
+ */
+static void emitUnary(int op)
+{
+  if (op == x_const) return;
+  if (lastConst(1))
+    comp->code[comp->num - 1].value = unaryValue(op, comp->code[comp->num - 1].value);
+  else emitExpr(op, 0, NULL, NULL);
+}
+
+/* compile memory reference $addr[:c] or register @name. Byte registers
+ * are resolved to a pointer now, other registers (pc, dptr, cycles) are
+ * looked up every time they are used. A constant address is checked now,
+ * memory is always read with getMemory().
+ */
+static void compileMem(char *expr)
+{
+  int addr = 0, len = strlen(expr), *mem;
+  char c = '\0', tmp, *ref = NULL;
+
+  if (expr[0] == '@')
     {
-      switch (expr[start])
+      if (!(mem = getMemExpr(expr, &addr, &c))) longjmp(*exprErr, no_mem);
+      safeDupStr(ref, expr);
+      emitExpr((addr == 1) ? x_reg : x_ref, sim->reg_gen, mem, ref);
+      return;
+    }
+
+  if (len>2 && expr[len - 2] == ':')
+    {
+      c = expr[len - 1];
+      tmp = expr[len - 2]; expr[len - 2] = '\0';
+      compileExpr_r(expr + 1);
+      expr[len - 2] = tmp;
+    }
+  else compileExpr_r(expr + 1);
+
+  if (lastConst(1) && getMemory(sim, comp->code[comp->num - 1].value, c) == UNDEF)
+    longjmp(*exprErr, no_mem);
+  emitExpr(x_mem, c, NULL, NULL);
+}
+
+/* compileExpr_r follows getExpr() but emits code instead of values
+ */
+static void compileExpr_r(char *expr)
+{
+  int pos, start = 0;
+  char op;
+
+  while (isOp(expr[start])) ++start;
+
+  if (expr[start]=='(' && !expr[start + (pos = findClosePar(expr + start, 0)) + 1])
+    {
+      expr[start + pos] = '\0';
+      compileExpr_r(expr + start + 1);
+      expr[start + pos] = ')';
+    }
+  else if (findOp(')', expr + start)>0)
+    {
+      longjmp(*exprErr, no_leftPar);
+    }
+  else if ((pos = findBinaryOp(expr + start)) != UNDEF)
+    {
+      if (expr[start + pos] == '=' && expr[start + pos + 1] != '=') 
+	longjmp(*exprErr, no_eq);
+      
+      op = expr[start + pos];
+      expr[start + pos] = '\0';
+      compileExpr_r(expr);
+      expr[start + pos] = op;
+            
+      if ((expr[start + pos] == expr[start + pos + 1]) || 
+	  (expr[start + pos + 1] == '=')) ++pos;
+      compileExpr_r(expr + start + pos + 1);
+      emitBinary(binaryOp(expr, pos));
+      return;
+    }
+  else if (isalpha(expr[start]))
+    {
+      emitExpr(x_const, getLabelValue(expr + start), NULL, NULL);
+    }
+  else if (isdigit(expr[start]))
+    {
+      emitExpr(x_const, getNumber(expr + start), NULL, NULL);
+    }
+  else if ((expr[start]=='$'|| expr[start]=='@'))
+    {
+      compileMem(expr + start);
+    }
+  else
+    {
+      longjmp(*exprErr, no_op); /* unknown opeator???? */
+    }
+  
+  while (start--) emitUnary(unaryOp(expr[start]));
+}
+
+/* compile expression. An expression left over by an error is freed
+ * with the next one.
+ */
+expr_code *compileExpr(char *expr)
+{
+  expr_code *code;
+
+  freeExpr(comp); comp = NULL;
+  free(comp_str); comp_str = NULL;
+  safeCalloc(comp, expr_code, 1);
+  safeDupStr(comp_str, expr);
+  compileExpr_r(comp_str);
+  free(comp_str); comp_str = NULL;
+
+  safeMalloc(comp->stack, int, comp->max);
+  code = comp; comp = NULL;
+  return code;
+}
+
+/* evalExpr runs the compiled expression on its stack
+ */
+int evalExpr(expr_code *expr)
+{
+  int *sp = expr->stack, *mem, addr;
+  char c;
+  expr_instr *ip, *end = expr->code + expr->num;
+
+  for (ip = expr->code; ip<end; ++ip)
+    {
+      switch (ip->op)
 	{
-	case '+': value = +value; break;
-	case '-': value = -value; break;
-	case '!': value = !value; break;
-	case '~': value = ~value; break;
-	default: 
-	  longjmp(*exprErr, no_op); /* unknown opeator???? */
+	case x_const: *sp++ = ip->value; break;
+	case x_reg:
+	  if (ip->value != sim->reg_gen)
+	    {
+	      if (!(ip->ptr = getMemExpr(ip->ref, &addr, &c))) longjmp(*exprErr, no_mem);
+	      ip->value = sim->reg_gen;
+	    }
+	  *sp++ = *ip->ptr;
+	  break;
+	case x_ref:
+	  if (!(mem = getMemExpr(ip->ref, &addr, &c))) longjmp(*exprErr, no_mem);
+	  *sp++ = *mem;
+	  break;
+	case x_mem:
+	  if ((sp[-1] = getMemory(sim, sp[-1], ip->value)) == UNDEF) longjmp(*exprErr, no_mem);
+	  break;
+	case x_neg: sp[-1] = -sp[-1]; break;
+	case x_not: sp[-1] = !sp[-1]; break;
+	case x_inv: sp[-1] = ~sp[-1]; break;
+	default:
+	  --sp;
+	  sp[-1] = binaryValue(ip->op, sp[-1], *sp);
 	  break;
 	}
     }
-  return value;
+  return sp[-1];
+}
+
+/* free compiled expression
+ */
+void freeExpr(expr_code *expr)
+{
+  int i;
+
+  if (!expr) return;
+  for (i = 0; i<expr->num; ++i) free(expr->code[i].ref);
+  free(expr->code);
+  free(expr->stack);
+  free(expr);
 }
 
 /* this function will allocate memory for the label array and will 
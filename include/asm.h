@@ -132,6 +132,50 @@ extern
 #endif
 int getExpr(char*);
 
+/* An expression compiled by compileExpr() is a postfix program for a
+ * stack machine. Constant subexpressions are folded, labels replaced by
+ * their values and memory and registers by pointers where possible.
+ */
+typedef struct
+{
+  int op;     /* operator, enum expr_op in expr.c          */
+  int value;  /* constant, memory type or register gen    */
+  int *ptr;   /* address of memory or register            */
+  char *ref;  /* memory reference to resolve when evaluated */
+} expr_instr;
+
+typedef struct
+{
+  int num;          /* number of instructions             */
+  int size;         /* allocated size of code             */
+  int depth;        /* stack depth while compiling        */
+  int max;          /* maximum stack depth of code        */
+  int *stack;       /* stack of evaluated values          */
+  expr_instr *code; /* instructions                       */
+} expr_code;
+
+/* compile expression to code evaluated by evalExpr(). Errors are the
+ * same as those of getExpr(). The expression is not changed.
+ */
+#ifndef EXPR_LOCAL
+extern
+#endif
+expr_code *compileExpr(char*);
+
+/* return value of compiled expression
+ */
+#ifndef EXPR_LOCAL
+extern
+#endif
+int evalExpr(expr_code*);
+
+/* free compiled expression
+ */
+#ifndef EXPR_LOCAL
+extern
+#endif
+void freeExpr(expr_code*);
+
 /* getNumber() will interpet the string given to it as a numerical constant
  */
 #ifndef EXPR_LOCAL
@@ -0,0 +1,60 @@
+/*************************************************************************************
+
+    Copyright (c) 2003 - 2005 by James L. Terman
+    This file is part of the Simulator
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ *************************************************************************************/
+#ifndef _BATCH_HEADER
+#define _BATCH_HEADER
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "snap.h"
+#include "cover.h"
+
+/* A batch runs the same assembled code many times from different
+ * starting states, given by a manifest with a line for each run.
+ * The runs are spread over threads, each with its own machine.
+ */
+
+/* add the run of a manifest line. count is the number of instructions
+ * executed, if the line does not give one. Errors longjmp to err
+ */
+#ifndef BATCH_LOCAL
+extern
+#endif
+void addBatchRun(char*, int);
+
+/* execute all added runs on the given number of threads. Every run
+ * starts with a cpu after powerOn() and the code memory image or, if
+ * the state is not NULL, with a machine forked from it. The code
+ * executed by the runs is merged into the cover map, if not NULL
+ */
+#ifndef BATCH_LOCAL
+extern
+#endif
+void runBatch(int, const uint8_t*, const sim_state*, cover_map*);
+
+/* write the final state of every run in the order they were added
+ */
+#ifndef BATCH_LOCAL
+extern
+#endif
+void printBatch(FILE*);
+
+#endif
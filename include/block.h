@@ -0,0 +1,125 @@
+/*************************************************************************************
+
+    Copyright (c) 2003 - 2005 by James L. Terman
+    This file is part of the Simulator
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ *************************************************************************************/
+#ifndef _BLOCK_HEADER
+#define _BLOCK_HEADER
+
+#include "asmdefs.h"
+
+typedef struct sim_ctx sim_ctx; /* see ctx.h */
+
+/* A block is a run of instructions starting at start that ends with a
+ * branch, jump, call or return (see isBranch()), before a break or after
+ * BLOCK_MAX instructions. The cpu backend pre-decodes the instructions
+ * into code. Writes to code memory are tracked per BLOCK_PAGE bytes, a
+ * block is valid as long as the generation of its pages has not changed.
+ */
+#define BLOCK_MAX 32
+#define BLOCK_PAGE 256
+
+#define BLOCK_EXEC 1  /* all instructions of block executed  */
+#define BLOCK_TAKEN 2 /* branch at end went to its target     */
+#define BLOCK_NEXT 4  /* branch at end fell through           */
+
+/* A block that branches back to its own start and does nothing but wait
+ * is a loop found by buildBlock(). A delay loop only counts a register
+ * down to 0, a poll loop only reads memory that nothing but an event can
+ * change (a halt is one too). skipLoop() runs it round at once.
+ */
+#define LOOP_MAX 4   /* most instructions in a poll loop */
+#define LOOP_DELAY 1 /* kind of loop                     */
+#define LOOP_POLL 2
+
+typedef struct block_struct
+{
+  int start;                    /* address of first instruction in block  */
+  int end;                      /* address following the block            */
+  int num;                      /* number of instructions in block        */
+  int cycles;                   /* table cycles of all instrs in block    */
+  int page[2];                  /* first and last code page of block      */
+  int gen[2];                   /* generation of first and last code page */
+  struct block_struct *next[2]; /* chained successors, jump & fall through */
+  int cover;                    /* BLOCK_EXEC etc. recorded in cover map  */
+  int cover_gen;                /* cover_gen of ctx when cover was set    */
+  int loop;                     /* LOOP_DELAY, LOOP_POLL or 0             */
+  void *code;                   /* instructions decoded by cpu backend    */
+} block_struct;
+
+/* codeWrite() has to be called for every write to code memory at addr
+ * of ctx s
+ */
+#define codeWrite(s, addr) if ((s)->code_map[addr]) invalidateCode(s, addr)
+
+/* drop all blocks containing the code address
+ */
+#ifndef BLOCK_LOCAL
+extern
+#endif
+void invalidateCode(sim_ctx*, int);
+
+/* drop all blocks, code memory has been replaced
+ */
+#ifndef BLOCK_LOCAL
+extern
+#endif
+void flushBlocks(sim_ctx*);
+
+/* run blocks at pc until count instructions are executed, cycles has
+ * reached limit, a break is found or a watch is hit (see watch.h).
+ * Returns the number of instructions left of count.
+ */
+#ifndef BLOCK_LOCAL
+extern
+#endif
+int runBlocks(sim_ctx*, int, unsigned long long);
+
+/* return how many times runBlocks() would execute block b, a loop that
+ * takes cycles c each time round, before count instructions, cycles
+ * limit or next_event are reached. The time round that reaches an event
+ * is not counted, as it may see it
+ */
+#ifndef BLOCK_LOCAL
+extern
+#endif
+int loopTimes(sim_ctx*, const block_struct*, int, int, unsigned long long);
+
+/* The following functions have to be defined in the cpu sim.c
+ * buildBlock() decodes the b->num instructions at b->start into b->code
+ * and sets b->loop. execBlock() executes them and returns the number of
+ * executed instrs. skipLoop() executes loop b once and, if it is waiting,
+ * as many more times as loopTimes() allows by only adding their cycles
+ * and changing its counter. It returns the number of executed instrs.
+ */
+#ifndef SIM_CPU_LOCAL
+extern
+#endif
+void buildBlock(sim_ctx*, block_struct*);
+
+#ifndef SIM_CPU_LOCAL
+extern
+#endif
+int execBlock(sim_ctx*, block_struct*);
+
+#ifndef SIM_CPU_LOCAL
+extern
+#endif
+int skipLoop(sim_ctx*, block_struct*, int, unsigned long long);
+
+#endif
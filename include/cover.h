@@ -0,0 +1,88 @@
+/*************************************************************************************
+
+    Copyright (c) 2003 - 2005 by James L. Terman
+    This file is part of the Simulator
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ *************************************************************************************/
+#ifndef _COVER_HEADER
+#define _COVER_HEADER
+
+#include <stdint.h>
+
+#include "asmdefs.h"
+#include "ctx.h"
+
+/* A cover_map records which code a machine has executed, a bit for each
+ * address in every bitmap. exec is set for an executed instruction,
+ * taken when a branch went to its target and next when it fell through
+ * to the following instruction. The maps of runs of the same code are
+ * merged by or'ing them. A machine records into its map while its cover
+ * is not NULL, blocks of code are only checked the first time they run.
+ */
+#define COVER_BYTES (MEMORY_MAX/8)
+#define COVER_MAGIC "uCOV"
+
+#define coverBit(addr) (1 << ((addr) % 8))
+#define isCovered(bits, addr) ((bits)[(addr)/8] & coverBit(addr))
+#define setCovered(bits, addr) ((bits)[(addr)/8] |= coverBit(addr))
+
+struct cover_map
+{
+  uint8_t exec[COVER_BYTES];  /* instruction executed            */
+  uint8_t taken[COVER_BYTES]; /* branch went to its target       */
+  uint8_t next[COVER_BYTES];  /* branch fell through             */
+};
+
+/* record the step of the instruction at addr of s into its map, pc is
+ * where the step went
+ */
+#ifndef COVER_LOCAL
+extern
+#endif
+void coverStep(sim_ctx*, int);
+
+/* start recording the code s executes into map, or stop it, if map is
+ * NULL
+ */
+#ifndef COVER_LOCAL
+extern
+#endif
+void setCover(sim_ctx*, cover_map*);
+
+/* or map from into map to
+ */
+#ifndef COVER_LOCAL
+extern
+#endif
+void mergeCover(cover_map*, const cover_map*);
+
+/* write map to file. Returns FALSE, if it could not be written
+ */
+#ifndef COVER_LOCAL
+extern
+#endif
+int saveCover(const cover_map*, const char*);
+
+/* merge the map in file into map. Returns FALSE, if the file could not
+ * be read or is not the map of this cpu
+ */
+#ifndef COVER_LOCAL
+extern
+#endif
+int loadCover(cover_map*, const char*);
+
+#endif
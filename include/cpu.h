@@ -21,10 +21,13 @@
 #ifndef _CPU_HEADER
 #define _CPU_HEADER
 
+#include <stdint.h>
+
 #include "asmdefs.h"
 #include "err.h"
 #include "asm.h"
 #include "front.h"
+#include "ctx.h"
 
 /* The following file defines the processor specific functions that must be
  * defined in the processor specific directory. CPU_LOCAL functions are 
@@ -34,7 +37,7 @@
 #ifndef PROC_LOCAL
 extern
 #endif
-void storeWord(int*, int);
+void storeWord(uint8_t*, int);
 
 #ifndef CPU_LOCAL
 extern 
@@ -64,45 +67,195 @@ extern
 #endif
 int isJSR(int);
 
+#ifndef CPU_LOCAL
+extern 
+#endif
+int isBranch(int);
+
+/* isCondBranch() returns TRUE for a branch that can fall through to the
+ * next instruction
+ */
+#ifndef CPU_LOCAL
+extern 
+#endif
+int isCondBranch(int);
+
 /*
  *
  *  Processor specific simulator Definitions
  *
  */
+
+/* newSim() creates a machine that runs on mem, or its own memory if
+ * mem is NULL (see initCtx()). freeSim() frees it again.
+ */
+#ifndef SIM_CPU_LOCAL
+extern 
+#endif
+sim_ctx *newSim(uint8_t*);
+
+#ifndef SIM_CPU_LOCAL
+extern 
+#endif
+void freeSim(sim_ctx*);
+
+#ifndef SIM_CPU_LOCAL
+extern 
+#endif
+void reset(sim_ctx*);
+
+/* powerOn() clears all ram and registers of the cpu, as newSim() leaves
+ * them, and does a reset(). Code memory is not changed.
+ */
+#ifndef SIM_CPU_LOCAL
+extern 
+#endif
+void powerOn(sim_ctx*);
+
+/* irq() requests an interrupt by its number. It returns TRUE if it is
+ * taken now, FALSE if not and UNDEF if isIrq() is FALSE for the number
+ */
+#ifndef SIM_CPU_LOCAL
+extern 
+#endif
+int isIrq(sim_ctx*, int);
+
+#ifndef SIM_CPU_LOCAL
+extern 
+#endif
+int irq(sim_ctx*, int);
+
+#ifndef SIM_CPU_LOCAL
+extern 
+#endif
+void step(sim_ctx*);
+
+/* syncEvents() brings the peripherals of the cpu up to its cycles,
+ * does what they have done since and sets next_event to the cycles of
+ * the next thing they will do. It is called when cycles has reached
+ * next_event and whenever the cpu stops or starts running, so their
+ * registers can be read and changed in between
+ */
+#ifndef SIM_CPU_LOCAL
+extern 
+#endif
+void syncEvents(sim_ctx*);
+
+/* canInterrupt() is TRUE if an interrupt is requested or will be by one
+ * of the events, and the cpu would take it. A halted cpu only runs on
+ * while it is
+ */
+#ifndef SIM_CPU_LOCAL
+extern 
+#endif
+int canInterrupt(sim_ctx*);
+
+/* setSerial() connects the serial port of the cpu to the host file
+ * descriptors out, for the bytes it sends, and in, for the bytes it
+ * receives. Either may be UNDEF. Returns FALSE if the cpu has no serial
+ * port. flushSerial() writes the bytes sent that are still buffered,
+ * it is called whenever the cpu stops
+ */
+#ifndef SIM_CPU_LOCAL
+extern 
+#endif
+int setSerial(sim_ctx*, int, int);
+
+#ifndef SIM_CPU_LOCAL
+extern 
+#endif
+void flushSerial(sim_ctx*);
+
+/* isHalt() returns TRUE, if the instruction at addr is an unconditional
+ * jump to itself. A cpu executing it will never get anywhere else
+ */
+#ifndef SIM_CPU_LOCAL
+extern 
+#endif
+int isHalt(sim_ctx*, int);
+
+#ifndef SIM_CPU_LOCAL
+extern 
+#endif
+int *getRegister(sim_ctx*, str_storage, int*, int*);
+
+/* getMemory() returns the byte at addr of the memory area given by the
+ * char or UNDEF, if there is none. setMemory() stores a byte there and
+ * returns FALSE, if there is none. Memory is read and written through
+ * these two, it may be code.
+ */
+#ifndef SIM_CPU_LOCAL
+extern 
+#endif
+int getMemory(sim_ctx*, int, char);
+
+#ifndef SIM_CPU_LOCAL
+extern 
+#endif
+int setMemory(sim_ctx*, int, char, int);
+
+/* watchArea() returns the WATCH_* area (see ctx.h) of the byte at addr
+ * of the memory area given by the char and sets *index to its index in
+ * the area and *bit to the mask of a bit address or BYTE_MASK. Returns
+ * UNDEF, if there is none
+ */
 #ifndef SIM_CPU_LOCAL
 extern 
 #endif
-void reset(void);
+int watchArea(sim_ctx*, int, char, int*, int*);
 
 #ifndef SIM_CPU_LOCAL
 extern 
 #endif
-int irq(int);
+void dumpMemory(sim_ctx*, FILE*);
 
 #ifndef SIM_CPU_LOCAL
 extern 
 #endif
-void step(void);
+void restoreMemory(sim_ctx*, FILE*);
 
+/* saveSnap() writes a binary snapshot of the machine (see snap.h) to
+ * a file descriptor, with code memory if the flag is TRUE or the cpu
+ * has no other memory. It returns FALSE if it could not. loadSnap()
+ * restores it from a mapped file and returns FALSE if the file is not
+ * a snapshot of this cpu. dumpMemory() and restoreMemory() are the
+ * text format of the same state
+ */
 #ifndef SIM_CPU_LOCAL
 extern 
 #endif
-int *getRegister(str_storage, int*, int*);
+int saveSnap(sim_ctx*, int, int);
 
 #ifndef SIM_CPU_LOCAL
 extern 
 #endif
-int *getMemory(int, char);
+int loadSnap(sim_ctx*, int);
 
+/* logStep() executes one instruction like step() and saves in the
+ * undo_rec what it changes, before it does. The record is complete
+ * even if the instruction stops with an error. undoStep() puts the
+ * machine back into the state before the step of the record
+ */
 #ifndef SIM_CPU_LOCAL
 extern 
 #endif
-void dumpMemory(FILE*);
+void logStep(sim_ctx*, undo_rec*);
 
 #ifndef SIM_CPU_LOCAL
 extern 
 #endif
-void restoreMemory(FILE*);
+void undoStep(sim_ctx*, const undo_rec*);
+
+/* create a machine from the snapshot in a file descriptor, as newSim()
+ * and loadSnap() would. Its memory is a private mapping of the file, a
+ * page is copied the first time the machine writes it. Returns NULL if
+ * the file is not a snapshot of this cpu with code memory
+ */
+#ifndef SIM_CPU_LOCAL
+extern 
+#endif
+sim_ctx *mapSim(int);
+
 
 /* number of tokens needed to define cpu instr
  */
@@ -115,8 +268,9 @@ void restoreMemory(FILE*);
 #define INSTR_TKN_PARAM 4
 
 #ifndef BACKEND_LOCAL
-int memory[MEMORY_MAX]; /* 64K of program memory                   */
-int pc;                 /* location of next instr to be assembled  */
+extern uint8_t memory[MEMORY_MAX]; /* 64K of program memory                  */
+extern int pc;                     /* location of next instr to be assembled */
+extern char instr_start[MEMORY_MAX]; /* TRUE where an instruction starts     */
 #endif
 
 /* the following global variables have to be defined in asm.c:
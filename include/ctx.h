@@ -0,0 +1,129 @@
+/*************************************************************************************
+
+    Copyright (c) 2003 - 2005 by James L. Terman
+    This file is part of the Simulator
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ *************************************************************************************/
+#ifndef _CTX_HEADER
+#define _CTX_HEADER
+
+#include <stdint.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include "asmdefs.h"
+#include "block.h"
+
+/* brk_map has a bit set for every address with a break
+ */
+#define BRK_BITS (8*sizeof(unsigned int))
+#define brkBit(addr) (1u << ((addr) % BRK_BITS))
+#define isBrk(s, addr) ((s)->brk_map[(addr)/BRK_BITS] & brkBit(addr))
+
+/* watch_map has the kinds of watches (see watch.h) on each page of
+ * WATCH_PAGE bytes of a memory area. Only accesses to a page with a
+ * watch of their kind take the slow path of watchByte()
+ */
+#define WATCH_PAGE 16
+#define WATCH_MEM 0   /* memory, the code memory of the 8051 */
+#define WATCH_XRAM 1  /* external ram of the 8051            */
+#define WATCH_RAM 2   /* internal ram of the 8051 by index   */
+#define WATCH_AREAS 3
+#define isWatched(s, area, addr, kind) ((s)->watch_map[area][(addr)/WATCH_PAGE] & (kind))
+
+typedef struct cover_map cover_map; /* see cover.h */
+typedef struct event_struct event_struct; /* see event.h */
+
+/* sim_ctx holds the state of one simulated machine that is not part
+ * of the cpu. Any number of them can be run in one process, each is
+ * created by the cpu backend with newSim(), which puts its registers
+ * in the same allocation.
+ *
+ * Each instruction adds INSTR_TKN_CYCLES from cpu_instr_tkn plus any
+ * extra cycles the cpu takes for it to cycles. The peripherals of the
+ * cpu only have to be looked at, when cycles reaches next_event (see
+ * syncEvents() in cpu.h), which is never after the first of events
+ * (see event.h). reg_gen changes when a
+ * register returned by getRegister() has moved, e.g. when another
+ * register bank is selected.
+ */
+struct sim_ctx
+{
+  uint8_t *memory;           /* 64K of program memory                    */
+  int own_memory;            /* TRUE if memory is freed with the ctx     */
+  int pc;                    /* address of next instr to be executed     */
+  unsigned long long cycles; /* cycles executed since reset()            */
+  unsigned long long next_event; /* cycles when syncEvents() is due      */
+  int reg_gen;               /* generation of register addresses         */
+  int irq_gen;               /* changed when an event requests an irq    */
+  jmp_buf *err;              /* cpu errors are reported by longjmp here  */
+
+  int code_written;                              /* a block was invalidated */
+  int code_gen[MEMORY_MAX/BLOCK_PAGE];           /* generation of code pages */
+  block_struct **block_table[MEMORY_MAX/BLOCK_PAGE]; /* blocks by start addr */
+  char code_map[MEMORY_MAX];                     /* TRUE if byte in a block  */
+
+  unsigned int brk_map[MEMORY_MAX/BRK_BITS]; /* bit set, if addr has break */
+
+  uint8_t watch_map[WATCH_AREAS][MEMORY_MAX/WATCH_PAGE]; /* watches by page  */
+  int watching;  /* number of watches set                               */
+  int watch_hit; /* number of watch hit by the last instruction or 0    */
+
+  event_struct *events;     /* min-heap of events by cycles         */
+  int num_event, size_event;
+
+  cover_map *cover; /* code executed is recorded here, if not NULL */
+  int cover_gen;    /* generation of cover, see setCover()        */
+
+  void *snap;      /* mapped snapshot with the memory of the machine */
+  size_t snap_len; /* or NULL, see mapSim()                          */
+};
+
+/* undo_rec holds what an instruction changed, so that it can be
+ * undone. where has the locations the cpu backend saved before the
+ * instruction overwrote them, as an index it decodes itself, and old
+ * their values. regs are the registers of the cpu not in memory.
+ */
+#define UNDO_WRITES 20
+#define UNDO_REGS 6
+
+typedef struct
+{
+  int pc_addr;               /* pc before the instruction              */
+  unsigned long long cycles; /* cycles before the instruction          */
+  int regs[UNDO_REGS];       /* registers not in memory                */
+  int num;                   /* number of saved locations              */
+  int where[UNDO_WRITES];    /* location saved                         */
+  int old[UNDO_WRITES];      /* value at location before instruction   */
+} undo_rec;
+
+/* set up the common part of a ctx. The machine runs on mem, if it is
+ * not NULL, otherwise on memory of its own.
+ */
+#ifndef BLOCK_LOCAL
+extern
+#endif
+void initCtx(sim_ctx*, uint8_t*);
+
+/* free everything initCtx() and running the machine have allocated
+ */
+#ifndef BLOCK_LOCAL
+extern
+#endif
+void freeCtx(sim_ctx*);
+
+#endif
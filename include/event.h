@@ -0,0 +1,83 @@
+/*************************************************************************************
+
+    Copyright (c) 2003 - 2005 by James L. Terman
+    This file is part of the Simulator
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ *************************************************************************************/
+#ifndef _EVENT_HEADER
+#define _EVENT_HEADER
+
+#include "asmdefs.h"
+#include "ctx.h"
+
+/* An event is something that happens to a machine when its cycles
+ * reach the cycles of the event, e.g. a timer of the cpu overflows or
+ * an interrupt requested by a script. The events of a machine are kept
+ * in a min-heap by cycles, so next_event of the sim_ctx only has to be
+ * compared with cycles to see if one is due. The cpu backend handles
+ * the due events in syncEvents() (see cpu.h).
+ */
+#define EVENT_IRQ 0   /* interrupt number value is requested, see irq() */
+#define EVENT_TIMER 1 /* timer number value of the cpu overflows        */
+#define EVENT_SERIAL 2 /* serial port of the cpu, value by cpu          */
+
+struct event_struct
+{
+  unsigned long long cycles; /* when the event is due */
+  int kind;                  /* EVENT_IRQ etc.        */
+  int value;                 /* depends on kind       */
+};
+
+/* add an event to machine s. next_event is lowered to it, if it is
+ * due before
+ */
+#ifndef EVENT_LOCAL
+extern
+#endif
+void addEvent(sim_ctx*, unsigned long long, int, int);
+
+/* remove the first event of s into *e, if it is due. Returns FALSE if
+ * none is
+ */
+#ifndef EVENT_LOCAL
+extern
+#endif
+int dueEvent(sim_ctx*, event_struct*);
+
+/* remove all events of a kind from s or all of them, if kind is UNDEF
+ */
+#ifndef EVENT_LOCAL
+extern
+#endif
+void delEvents(sim_ctx*, int);
+
+/* return the cycles of the first event of s or ULLONG_MAX, if there is
+ * none
+ */
+#ifndef EVENT_LOCAL
+extern
+#endif
+unsigned long long firstEvent(sim_ctx*);
+
+/* return the events of s in no order and their number in *num
+ */
+#ifndef EVENT_LOCAL
+extern
+#endif
+const event_struct *getEvents(sim_ctx*, int*);
+
+#endif
@@ -28,10 +28,18 @@ typedef struct
   int tmp;    /* True if break cleared when hit */
   int used;   /* True if entry a valid break */
   int pc;     /* address of break */
-  int op;     /* opcode that break entry in memory[] replaced */
+  int next;   /* next free entry, if entry not used */
   char *expr; /* if not NULL, break only if expr evaluates non-zero */
+  expr_code *code; /* expr compiled by addBrk() */
 } brk_struct;
 
+/* the machine the debugger commands work on. Its breaks are set in
+ * its brk_map (see ctx.h)
+ */
+#ifndef SIM_LOCAL
+extern sim_ctx *sim;
+#endif
+
 #ifndef SIM_LOCAL
 extern const str_storage simErrMsg[];
 #endif
@@ -45,6 +53,13 @@ extern
 #endif
 int *getMemExpr(char*, int*, char*);
 
+/* return value of expression. Compiled expressions are kept for reuse
+ */
+#ifndef SIM_LOCAL
+extern
+#endif
+int getSimExpr(char*);
+
 /* set a temporary break for next command
  */
 #ifndef SIM_LOCAL
@@ -73,13 +88,86 @@ extern
 #endif
 void stepOne(void);
 
+/* waitHalt will step the halt at pc and skip what is left of n steps
+ * up to just before the next event. Returns the steps executed
+ */
+#ifndef SIM_LOCAL
+extern
+#endif
+unsigned long long waitHalt(unsigned long long);
+
+/* undo log of the steps executed. setUndo() sets the number of steps
+ * kept, 0 turns it off. clearUndo() drops the steps logged so far.
+ * stepBack() undoes one step, runBack() undoes steps until a break
+ */
+#ifndef SIM_LOCAL
+extern
+#endif
+void setUndo(int);
+
+#ifndef SIM_LOCAL
+extern
+#endif
+void clearUndo(void);
+
+#ifndef SIM_LOCAL
+extern
+#endif
+int stepBack(void);
+
+#ifndef SIM_LOCAL
+extern
+#endif
+int runBack(void);
+
+/* profile of the steps executed. setProfile(TRUE) clears it and starts
+ * counting, FALSE stops it. getProfile() returns the number of times
+ * an address was executed and the cycles it took
+ */
+#ifndef SIM_LOCAL
+extern
+#endif
+void setProfile(int);
+
+#ifndef SIM_LOCAL
+extern
+#endif
+unsigned long long getProfile(int, unsigned long long*);
+
+/* a node of the call graph of the profile is a subroutine called along
+ * the path of calls to its parent node. Nodes are linked to the nodes
+ * they call by child and next
+ */
+typedef struct
+{
+  int addr;                  /* address of subroutine                */
+  int parent;                /* node that called it or UNDEF         */
+  int child;                 /* first node it called or UNDEF        */
+  int next;                  /* next node called by parent or UNDEF  */
+  unsigned long long calls;  /* number of times it was called        */
+  unsigned long long cycles; /* cycles of its instructions, not calls */
+} call_node;
+
+#ifndef SIM_LOCAL
+extern
+#endif
+const call_node *getCalls(int*);
+
 /* run will start executing at pc or the address given it until break
+ * or a watch is hit (see watch.h)
  */
 #ifndef SIM_LOCAL
 extern
 #endif
 int run(int, int);
 
+/* runFor will execute a number of instructions or cycles without display
+ */
+#ifndef SIM_LOCAL
+extern
+#endif
+int runFor(unsigned long long, int, unsigned long long*);
+
 /* print break number. Print all if UNDEF, return TRUE if break exists
  */
 #ifndef SIM_LOCAL
@@ -0,0 +1,120 @@
+/*************************************************************************************
+
+    Copyright (c) 2003 - 2005 by James L. Terman
+    This file is part of the Simulator
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ *************************************************************************************/
+#ifndef _SNAP_HEADER
+#define _SNAP_HEADER
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "ctx.h"
+
+/* A snapshot is the binary core file of a machine. It starts with a
+ * snap_header, which the cpu backend extends with its registers, and
+ * is followed by its memory regions, each as raw bytes. It is written
+ * in the byte order of the host, with one writev() and read back by
+ * mapping the file.
+ */
+#define SNAP_MAGIC "uSIM"
+#define SNAP_VERSION 1
+
+#define SNAP_CODE 1 /* flag: code memory is one of the regions */
+
+typedef struct
+{
+  char magic[4];     /* SNAP_MAGIC                               */
+  uint16_t version;  /* SNAP_VERSION                             */
+  uint16_t size;     /* size of header with the cpu registers    */
+  char cpu[8];       /* name of the cpu, e.g. "6502"             */
+  uint32_t flags;    /* SNAP_CODE                                */
+  uint32_t pc_addr;  /* address of next instr to be executed     */
+  uint64_t cycles;   /* cycles executed since reset()            */
+} snap_header;
+
+/* fill in the header of a snapshot of s. size is the size of the
+ * struct of cpu registers that starts with the header
+ */
+#ifndef SNAP_LOCAL
+extern
+#endif
+void initSnap(snap_header*, sim_ctx*, const char*, int, int);
+
+/* write the header and regions given by iov to file descriptor fd with
+ * one writev(). Returns FALSE if not all of it was written
+ */
+#ifndef SNAP_LOCAL
+extern
+#endif
+int writeSnap(int, const struct iovec*, int);
+
+/* map the snapshot in file descriptor fd. Returns NULL if it is not a
+ * snapshot of the named cpu, otherwise the header and its total size
+ * in *len. If write is TRUE, the mapping is private and can be written
+ * without changing the file. The caller checks the regions and calls
+ * unmapSnap()
+ */
+#ifndef SNAP_LOCAL
+extern
+#endif
+snap_header *mapSnap(int, const char*, size_t*, int);
+
+#ifndef SNAP_LOCAL
+extern
+#endif
+void unmapSnap(const void*, size_t);
+
+/* return TRUE if file descriptor fd starts with SNAP_MAGIC
+ */
+#ifndef SNAP_LOCAL
+extern
+#endif
+int isSnap(int);
+
+/* A sim_state is the frozen state of a machine in a snapshot file.
+ * Any number of machines can be forked from it with mapSim(). They
+ * share its memory pages until they write one, so each machine only
+ * costs the pages it has changed.
+ */
+typedef struct sim_state sim_state;
+
+/* save the state of s. Returns NULL if it can not be written
+ */
+#ifndef SNAP_LOCAL
+extern
+#endif
+sim_state *saveState(sim_ctx*);
+
+/* create a machine in the state saved, it is freed with freeSim().
+ * Returns NULL if the snapshot can not be mapped
+ */
+#ifndef SNAP_LOCAL
+extern
+#endif
+sim_ctx *forkState(const sim_state*);
+
+/* the machines forked from state are not affected
+ */
+#ifndef SNAP_LOCAL
+extern
+#endif
+void freeState(sim_state*);
+
+#endif
@@ -0,0 +1,104 @@
+/*************************************************************************************
+
+    Copyright (c) 2003 - 2005 by James L. Terman
+    This file is part of the Simulator
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ *************************************************************************************/
+#ifndef _WATCH_HEADER
+#define _WATCH_HEADER
+
+#include <stdio.h>
+
+#include "asmdefs.h"
+#include "ctx.h"
+
+/* A watch stops the machine after an instruction that read, wrote or
+ * changed a byte or bit in its range. A read is a load of the data of
+ * an instruction, e.g. its operand or a byte pulled off the stack, not
+ * the fetch of the instruction itself. A bit is read or written with
+ * its byte. The cpu backend calls watchByte() for an access to a page
+ * marked in the watch_map of the machine (see ctx.h).
+ */
+#define WATCH_READ 1   /* byte was read                    */
+#define WATCH_WRITE 2  /* byte was written                 */
+#define WATCH_CHANGE 4 /* byte was written with a new value */
+
+typedef struct
+{
+  int used;  /* FALSE if entry is free                 */
+  int kind;  /* WATCH_READ etc.                        */
+  char m;    /* memory area as given, e.g. 'x'         */
+  int addr;  /* first address of range                 */
+  int len;   /* number of addresses in range           */
+  int area;  /* area in watch_map and index of first   */
+  int first; /* and last byte of range                 */
+  int last;
+  int bit;   /* bits watched in each byte              */
+  int next;  /* next free entry, if not used           */
+} watch_struct;
+
+/* the access that hit a watch
+ */
+typedef struct
+{
+  int kind;  /* kind of access                 */
+  int addr;  /* address in range of the watch  */
+  int old;   /* value of byte before and       */
+  int value; /* after the access               */
+} watch_event;
+
+/* a byte at index of area of s has been accessed. kind is WATCH_READ
+ * or WATCH_WRITE, old is its value before and value after the access
+ */
+#ifndef WATCH_LOCAL
+extern
+#endif
+void watchByte(sim_ctx*, int, int, int, int, int);
+
+/* watch len bytes at addr of memory area m (see getMemory()) of s for
+ * the kinds of accesses. Returns the number of the watch, errors
+ * longjmp to err
+ */
+#ifndef WATCH_LOCAL
+extern
+#endif
+int addWatch(sim_ctx*, char, int, int, int);
+
+/* delete watch number n of s, all of them if UNDEF. Returns FALSE, if
+ * there is no such watch
+ */
+#ifndef WATCH_LOCAL
+extern
+#endif
+int delWatch(sim_ctx*, int);
+
+/* return the watches and their number in *num. Watch n is entry n - 1,
+ * deleted ones are not used
+ */
+#ifndef WATCH_LOCAL
+extern
+#endif
+const watch_struct *getWatches(int*);
+
+/* return the access that hit a watch last
+ */
+#ifndef WATCH_LOCAL
+extern
+#endif
+const watch_event *getWatchEvent(void);
+
+#endif
@@ -0,0 +1,90 @@
+/*************************************************************************************
+
+    Copyright (c) 2003 - 2005 by James L. Terman
+    This file is part of the 6502 Assembler backend
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ *************************************************************************************/
+#ifndef _ALU_HEADER
+#define _ALU_HEADER
+
+/* adc and sbc of the simulator. mkalu uses these to generate the
+ * decimal mode tables in alu_table.h. sim.c looks up the result of a
+ * decimal adc or sbc in them, if acc and value are bytes. Binary adc
+ * and sbc are cheaper to compute than to look up.
+ *
+ * A table entry packs the result with the new V and C flags, it is
+ * indexed by the carry, acc and value.
+ */
+#define ALU_SIZE (2*BYTE_MAX*BYTE_MAX)
+
+#define aluIndex(c, a, b) (((c)*BYTE_MAX + (a))*BYTE_MAX + (b))
+#define aluPack(r, v, c) ((r)*4 + (v)*2 + (c))
+#define aluResult(e) ((e) >> 2)
+#define aluV(e) (((e) >> 1) & 1)
+#define aluC(e) ((e) & 1)
+
+/* overflow is set from bit 7 and 6 of the result
+ */
+#define aluOV(r) (((r) & BIT7_MASK) != 0) ^ (((r) & BIT6_MASK) != 0)
+
+/* add value and carry c to acc, in decimal if d is set
+ */
+static int aluAdc(int acc, int value, int c, int d)
+{
+  int dlo, dhi;
+  if (d)
+    {
+      dlo = (acc & LO_NYBLE) + (value & LO_NYBLE) + c;
+      dhi = (acc & HI_NYBLE) + (value & HI_NYBLE) + dlo/10;
+      dlo %= 10;
+      c = dhi>9;
+      dhi %= 10;
+      acc = dlo + 10*dhi;
+    }
+  else
+    {
+      acc += value + c;
+      c = acc >= (BYTE_MAX-1);
+      acc &= BYTE_MASK;
+    }
+  return aluPack(acc, aluOV(acc), c);
+}
+
+/* sub value and borrow !c from acc, in decimal if d is set
+ */
+static int aluSbc(int acc, int value, int c, int d)
+{
+  int dlo, dhi;
+  if (d)
+    {
+      dlo = (acc & LO_NYBLE) - (value & LO_NYBLE) - !c;
+      dhi = (acc & HI_NYBLE) - (value & HI_NYBLE) - (dlo<0);
+      if (dlo<0) dlo += 10;
+      c = dhi < 0;
+      if (dhi<0) dlo += 10;
+      acc = dlo + 10*dhi;
+    }
+  else
+    {
+      acc -= value + !c;
+      c = acc < 0;
+      acc &= BYTE_MASK;
+    }
+  return aluPack(acc, aluOV(acc), c);
+}
+
+#endif
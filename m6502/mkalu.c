@@ -0,0 +1,172 @@
+/*************************************************************************************
+
+    Copyright (c) 2003 - 2005 by James L. Terman
+    This file is part of the 6502 Assembler backend
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ *************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+
+/* mkalu writes the decimal adc and sbc tables of the simulator to stdout.
+ * Built with ALU_CHECK, it checks the tables in the generated alu_table.h
+ * and the functions in alu.h against the arithmetic sim.c had before them
+ */
+
+#include "asmdefs.h"
+#include "alu.h"
+
+#ifdef ALU_CHECK
+#include "alu_table.h"
+#endif
+
+typedef int (*aluFunc)(int, int, int, int);
+
+#ifndef ALU_CHECK
+/* write table name of function f
+ */
+static void writeTable(const char *name, aluFunc f)
+{
+  int c, a, b, n = 0;
+
+  printf("const short %s[ALU_SIZE] =\n  {", name);
+  for (c = 0; c<2; ++c)
+    for (a = 0; a<BYTE_MAX; ++a)
+      for (b = 0; b<BYTE_MAX; ++b)
+	printf("%s%d,", (n++ % 12) ? " " : "\n    ", f(a, b, c, TRUE));
+  printf("\n  };\n\n");
+}
+#else
+/* reference: doAdd() and doSub() as they were in sim.c before alu.h,
+ * with the P status register bits they use
+ */
+#define sign 128
+#define ov    64
+#define bcd    8
+#define zero   2
+#define carry  1
+
+#define setBit(x, addr, bit) (*(addr) = (x) ? *(addr) | bit : *(addr) & (BYTE_MASK - (bit)))
+#define setP(n, m) setBit(n, &psr, m);
+#define getC() (psr & carry)
+
+static int acc, psr;
+
+/* add value to acc with the proper setting of status registers.
+ * carry is used according to carryFlag but always set afterwards
+ */
+static void doAdd(int value)
+{
+  int dlo, dhi;
+  if (psr & bcd)
+    {
+      dlo = (acc & LO_NYBLE) + (value & LO_NYBLE) + getC();
+      dhi = (acc & HI_NYBLE) + (value & HI_NYBLE) + dlo/10;
+      dlo %= 10;
+      setP(dhi>9, carry);
+      dhi %= 10;
+      acc = dlo + 10*dhi;
+    }
+  else
+    {
+      acc += value + getC();
+      setP(acc >= (BYTE_MAX-1), carry);
+      acc &= BYTE_MASK;
+    }
+  setP(acc & sign, sign);
+  setP(((acc & BIT7_MASK) != 0) ^ ((acc & BIT6_MASK) != 0), ov);
+  setP(!acc, zero);
+}
+
+/* doSub sub value from acc setting status flags correctly afterwards
+ */
+static void doSub(int value)
+{
+  int dlo, dhi;
+  if (psr & bcd)
+    {
+      dlo = (acc & LO_NYBLE) - (value & LO_NYBLE) - !getC();
+      dhi = (acc & HI_NYBLE) - (value & HI_NYBLE) - (dlo<0);
+      if (dlo<0) dlo += 10;
+      setP(dhi < 0, carry);
+      if (dhi<0) dlo += 10;
+      acc = dlo + 10*dhi;
+    }
+  else
+    {
+      acc -= value + !getC();
+      setP(acc < 0, carry);
+      acc &= BYTE_MASK;
+    }
+  setP(acc & sign, sign);
+  setP(((acc & BIT7_MASK) != 0) ^ ((acc & BIT6_MASK) != 0), ov);
+  setP(!acc, zero);
+}
+
+/* run the reference adc or sbc on a, b, carry c and decimal flag d,
+ * return acc, V and C packed as in the tables
+ */
+static int refAlu(void (*op)(int), int a, int b, int c, int d)
+{
+  acc = a;
+  psr = ((c) ? carry : 0) | ((d) ? bcd : 0);
+  op(b);
+  return aluPack(acc, (psr & ov) != 0, getC());
+}
+
+static int refAdc(int a, int b, int c, int d) { return refAlu(&doAdd, a, b, c, d); }
+static int refSbc(int a, int b, int c, int d) { return refAlu(&doSub, a, b, c, d); }
+
+/* return number of inputs for which f, or table in decimal mode,
+ * is not what the reference ref returns
+ */
+static int checkTable(const char *name, const short *table, aluFunc f, aluFunc ref)
+{
+  int d, c, a, b, e, r, bad = 0;
+
+  for (d = 0; d<2; ++d)
+    for (c = 0; c<2; ++c)
+      for (a = 0; a<BYTE_MAX; ++a)
+	for (b = 0; b<BYTE_MAX; ++b)
+	  {
+	    r = ref(a, b, c, d);
+	    e = (d) ? table[aluIndex(c, a, b)] : f(a, b, c, d);
+	    if (e != r || f(a, b, c, d) != r || aluResult(e)*4 + aluV(e)*2 + aluC(e) != e)
+	      {
+		if (!bad++) 
+		  printf("%s: d=%d c=%d a=%02X b=%02X is %d not %d\n", 
+			 name, d, c, a, b, e, r);
+	      }
+	  }
+  return bad;
+}
+#endif
+
+int main(void)
+{
+#ifndef ALU_CHECK
+  printf("/* generated by mkalu from alu.h, do not edit */\n\n");
+  writeTable("adc_table", &aluAdc);
+  writeTable("sbc_table", &aluSbc);
+  return 0;
+#else
+  int bad = checkTable("adc_table", adc_table, &aluAdc, &refAdc) + 
+    checkTable("sbc_table", sbc_table, &aluSbc, &refSbc);
+
+  printf("alu tables %s\n", (bad) ? "failed" : "okay");
+  return bad != 0;
+#endif
+}
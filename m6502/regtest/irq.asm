@@ -0,0 +1,21 @@
+count	    equ	10h
+
+	org 200h
+start:	sei			; an irq requested now is held until cli
+	ldx #100
+wait:	dex
+	bne wait
+	cli
+	nop
+done:	jmp done		; halt until the nmi
+
+	org 300h
+irqhnd:	inc count
+	rti
+nmihnd:	inc count + 1
+	rti
+
+	org 0FFFAh
+	db nmihnd%256, nmihnd/256
+	db start%256, start/256
+	db irqhnd%256, irqhnd/256
@@ -21,12 +21,20 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <assert.h>
 
 #define SIM_CPU_LOCAL
 
 #include "proc.h"
 #include "cpu.h"
+#include "block.h"
+#include "snap.h"
+#include "watch.h"
+#include "event.h"
+#include "alu.h"
+#include "alu_table.h"
 
 const str_storage proc_error_messages[] = { 0 };
 
@@ -43,61 +51,150 @@ const str_storage proc_error_messages[] = { 0 };
 #define STACK_BASE 0x100
 
 #define setP(n, m) setBit(n, &psr, m);
-#define setC(n) setBit(n, &psr, carry)
-#define getC() (psr & carry)
-
-/* Allocation of internal registers
- */
-static int acc, xreg, yreg, psr, sptr;
-
-/* table of register use for each 6502 instruction
- * that is not in the parameter list
- */
-static int *instrReg_table[LAST_PROC_TOKEN - PROC_TOKEN] = 
-  { 
-     NULL,  NULL,  NULL,   NULL,  NULL,  NULL,  NULL,  NULL, 
-     NULL,  NULL,  NULL,   NULL,  NULL,  NULL,  NULL,  NULL, 
-     NULL,  NULL,  NULL,   NULL,  NULL,  NULL,  &acc, &xreg, 
-    &yreg,  NULL, &xreg,  &yreg,  NULL,  NULL, &xreg, &yreg, 
-     NULL,  NULL,  &acc,  &xreg, &yreg,  NULL,  NULL,  &acc, 
-     NULL,  NULL,  &acc,   &psr,  &acc,  &psr,  NULL,  NULL,
-     NULL,  NULL,  &acc,   NULL,  NULL,  NULL,  NULL,  &acc, 
-    &xreg, &yreg,  &xreg, &yreg,  NULL, &xreg,  NULL, &yreg,  
-     NULL,  NULL
-};
+
+/* A 6502 is allocated as cpu_ctx by newSim(). Its sim_ctx comes first,
+ * so the sim_ctx* given to the functions below is the cpu_ctx*. Every
+ * function running the cpu has it in cpu, the macros below name its
+ * registers and memory.
+ *
+ * While instructions execute, the N, Z, C and V flags of psr are kept
+ * apart: N is the sign bit of nres, Z is set if zres is 0, C and V are
+ * 0 or 1 in cflag and vflag. Instructions only store the result they
+ * computed, psr is put together with storeP() when a block or step is
+ * done or an instruction needs it. loadP() takes the flags from psr.
+ */
+typedef struct
+{
+  sim_ctx sim;                    /* memory, pc, cycles and blocks */
+  int acc, xreg, yreg, psr, sptr; /* internal registers            */
+  int nres, zres, cflag, vflag;   /* N, Z, C and V flags           */
+  int irq_held;                   /* TRUE if an irq waits for cli  */
+  undo_rec *log;                  /* stores are saved here, if set */
+} cpu_ctx;
+
+#define acc    (cpu->acc)
+#define xreg   (cpu->xreg)
+#define yreg   (cpu->yreg)
+#define psr    (cpu->psr)
+#define sptr   (cpu->sptr)
+#define nres   (cpu->nres)
+#define zres   (cpu->zres)
+#define cflag  (cpu->cflag)
+#define vflag  (cpu->vflag)
+#define memory (cpu->sim.memory)
+#define pc     (cpu->sim.pc)
+
+#define cpuErr(n) longjmp(*cpu->sim.err, n)
+
+#define setC(n) (cflag = (n))
+#define getC() cflag
+#define setNZ(n) nres = zres = (n)
+
+#define loadP() \
+  nres = psr & sign; zres = !(psr & zero); cflag = psr & carry; vflag = !!(psr & ov)
+#define storeP() \
+  psr = (psr & (BYTE_MASK - sign - ov - zero - carry)) | (nres & sign) | \
+    (vflag*ov) | (!zres*zero) | cflag
+
+/* save the byte at memory m in the undo log, before it is overwritten
+ */
+#define logged(m) if (cpu->log) logByte(cpu, m)
+
+static void logByte(cpu_ctx *cpu, const uint8_t *m)
+{
+  undo_rec *r = cpu->log;
+
+  r->where[r->num] = m - memory;
+  r->old[r->num++] = *m;
+}
+
+/* while there are watches (w is TRUE), an access to a byte m in a
+ * watched page takes the slow path of watchByte()
+ */
+#define watched(m, kind, w) ((w) && isWatched(&cpu->sim, WATCH_MEM, (m) - memory, kind))
+#define watchWrite(m, value, w) \
+  if (watched(m, WATCH_WRITE, w)) watchByte(&cpu->sim, WATCH_MEM, (m) - memory, WATCH_WRITE, *(m), value)
+#define watchRead(m, w) \
+  if (watched(m, WATCH_READ, w)) watchByte(&cpu->sim, WATCH_MEM, (m) - memory, WATCH_READ, *(m), *(m))
 
 /* put value on top of stack and decrement stack pointer by 1 
  */
-static void pushStack(int data)
+static void pushStack(cpu_ctx *cpu, int data)
 {
+  logged(memory + STACK_BASE + sptr);
+  watchWrite(memory + STACK_BASE + sptr, data, cpu->sim.watching);
   memory[STACK_BASE + sptr] = data;
+  codeWrite(&cpu->sim, STACK_BASE + sptr);
   dec(sptr);
 }
 
 /* increase stack pointer and return value from top of stack
  */
-static int popStack(void)
+static int popStack(cpu_ctx *cpu)
 {
   inc(sptr);  
+  watchRead(memory + STACK_BASE + sptr, cpu->sim.watching);
   return memory[STACK_BASE + sptr];
 }
 
+/* create a 6502 that runs on mem or its own memory (see initCtx())
+ */
+sim_ctx *newSim(uint8_t *mem)
+{
+  cpu_ctx *cpu = NULL;
+
+  safeCalloc(cpu, cpu_ctx, 1);
+  initCtx(&cpu->sim, mem);
+  return &cpu->sim;
+}
+
+/* free the 6502 of s
+ */
+void freeSim(sim_ctx *s)
+{
+  freeCtx(s);
+  free(s);
+}
+
 /* Put cpu in correct state after reset
  */
-void reset(void)
+void reset(sim_ctx *s)
 {
+  cpu_ctx *cpu = (cpu_ctx*) s;
+
   acc = xreg = yreg = psr = 0;
   sptr = BYTE_MAX - 1;
   pc = memory[RESET] + memory[RESET + 1]*BYTE_MAX;
+  cpu->sim.cycles = 0;
+  cpu->irq_held = FALSE;
+  delEvents(s, UNDEF);
+}
+
+/* all ram of the 6502 is its code memory, reset() sets every register
+ */
+void powerOn(sim_ctx *s)
+{
+  reset(s);
+}
+
+/* 0 is the irq, 1 the nmi
+ */
+int isIrq(sim_ctx *s, int nmi)
+{
+  return nmi == 0 || nmi == 1;
 }
 
-int irq(int nmi)
+int irq(sim_ctx *s, int nmi)
 {
+  cpu_ctx *cpu = (cpu_ctx*) s;
+
+  if (!isIrq(s, nmi)) return UNDEF;
   if (!nmi && psr & intr) return FALSE; /* check for maskable interrupt */
-  if (nmi < 0 || nmi > 1) return UNDEF;
-  pushStack(getHigh(pc));
-  pushStack(getLow(pc));
-  pushStack(p);
+  pushStack(cpu, getHigh(pc));
+  pushStack(cpu, getLow(pc));
+  pushStack(cpu, psr); /* psr is up to date, while the cpu is stopped */
+  psr |= intr;
+  cpu->sim.cycles += 7;
   if (nmi)
     pc = memory[NMI] + memory[NMI + 1]*BYTE_MAX;
   else
@@ -106,340 +203,646 @@ int irq(int nmi)
 }
 
 /* add value to acc with the proper setting of status registers.
- * carry is used according to carryFlag but always set afterwards
+ * A decimal result is looked up in adc_table, if acc and value are bytes
  */
-static void doAdd(int value)
+static void doAdd(cpu_ctx *cpu, int value)
 {
-  int dlo, dhi;
-  if (psr & bcd)
-    {
-      dlo = (acc & LO_NYBLE) + (value & LO_NYBLE) + getC();
-      dhi = (acc & HI_NYBLE) + (value & HI_NYBLE) + dlo/10;
-      dlo %= 10;
-      setP(dhi>9, carry);
-      dhi %= 10;
-      acc = dlo + 10*dhi;
-    }
+  int e;
+  if ((psr & bcd) && (unsigned) (acc | value) < BYTE_MAX)
+    e = adc_table[aluIndex(cflag, acc, value)];
   else
-    {
-      acc += value + getC();
-      setP(acc >= (BYTE_MAX-1), carry);
-      acc &= BYTE_MASK;
-    }
-  setP(acc & sign, sign);
-  setP(((acc & BIT7_MASK) != 0) ^ ((acc & BIT6_MASK) != 0), ov);
-  setP(!acc, zero);
+    e = aluAdc(acc, value, cflag, psr & bcd);
+  acc = aluResult(e); setNZ(acc); vflag = aluV(e); cflag = aluC(e);
 }
 
 /* doSub sub value from acc setting status flags correctly afterwards
  */
-static void doSub(int value)
+static void doSub(cpu_ctx *cpu, int value)
+{
+  int e;
+  if ((psr & bcd) && (unsigned) (acc | value) < BYTE_MAX)
+    e = sbc_table[aluIndex(cflag, acc, value)];
+  else
+    e = aluSbc(acc, value, cflag, psr & bcd);
+  acc = aluResult(e); setNZ(acc); vflag = aluV(e); cflag = aluC(e);
+}
+
+/* uop_struct is an instruction decoded for its handler. ea is the
+ * address given by the operand bytes at code (if any). left is the
+ * cycles of the instructions after it in its block, which execBlock()
+ * has added already, if the handler stops the block with an error.
+ */
+typedef struct uop_struct
+{
+  void (*exec)(cpu_ctx*, const struct uop_struct*); /* handler */
+  uint8_t *code;                          /* operand bytes       */
+  uint8_t *ea;                            /* operand as address  */
+  int cycles;                             /* cycles of opcode    */
+  int left;                               /* cycles after it     */
+} uop_struct;
+
+/* Every opcode has its own handler, specialized for the instruction
+ * and its addressing mode, in exec_table[]. The handlers are built
+ * from the macros below: EA_* evaluates the address of the parameter
+ * from the decoded instruction, the upper case macros hold the
+ * instruction itself and OP/OP0 wrap both into a handler that first
+ * moves pc to the next instruction. Each handler is built twice, the
+ * one ending in _w checks its accesses for watches and is only used
+ * while there are some.
+ */
+#define nextPC(bytes) \
+  pc += bytes; \
+  if (pc>=MEMORY_MAX) { pc = 0; storeP(); cpu->sim.cycles -= u->left; cpuErr(pc_overflow); }
+
+#define OP(name, bytes, mode, instr) \
+  static void name(cpu_ctx *cpu, const uop_struct *u) { nextPC(bytes); instr(mode, FALSE); } \
+  static void name##_w(cpu_ctx *cpu, const uop_struct *u) { nextPC(bytes); instr(mode, TRUE); }
+#define OP0(name, instr) \
+  static void name(cpu_ctx *cpu, const uop_struct *u) { nextPC(1); instr; } \
+  static void name##_w(cpu_ctx *cpu, const uop_struct *u) { name(cpu, u); }
+
+/* parameter addressing modes. The indirect modes only read the low
+ * byte of the address except jmp (), and (zp),x is listed for the
+ * and/rol opcodes 0x35, 0x36 in cpu_instr_tkn and is kept as such.
+ * An absolute address plus an index wraps around in 16 bits, as does
+ * the high byte of the pointer of jmp ()
+ */
+#define wrap16(p) (memory + (((p) - memory) & 0xFFFF))
+#define EA_imm  (u->code)
+#define EA_rel  (u->code)
+#define EA_zp   (u->ea)
+#define EA_zpx  (u->ea + xreg)
+#define EA_zpy  (u->ea + yreg)
+#define EA_abs  (u->ea)
+#define EA_abx  wrap16(u->ea + xreg)
+#define EA_aby  wrap16(u->ea + yreg)
+#define EA_izp  (memory + u->ea[0])
+#define EA_izx  (memory + u->ea[xreg])
+#define EA_izy  (EA_izp + yreg)
+#define EA_izpx (EA_izp + xreg)
+#define EA_ind  (memory + u->ea[0] + *wrap16(u->ea + 1)*BYTE_MAX)
+
+/* reading through an indexed address takes one more cycle, if adding
+ * the index crosses a page
+ */
+#define cross(lo, idx) (cpu->sim.cycles += ((lo) + (idx) >= BYTE_MAX))
+#define EA_abxp (cross(u->code[0], xreg), EA_abx)
+#define EA_abyp (cross(u->code[0], yreg), EA_aby)
+#define EA_izyp (cross(u->ea[0], yreg), EA_izy)
+
+/* any store to memory has to be checked for code being changed
+ */
+#define written(m) codeWrite(&cpu->sim, (m) - memory)
+#define store(m, value, w) logged(m); watchWrite(m, value, w); *m = value; written(m)
+
+/* m is the byte read by an instruction. An immediate operand is part of
+ * the instruction, it is not a read for watches
+ */
+#define load(e, w) const uint8_t *m = (e); \
+  if (watched(m, WATCH_READ, w) && m != u->code) watchByte(&cpu->sim, WATCH_MEM, m - memory, WATCH_READ, *m, *m)
+
+#define ADC(e, w) { load(e, w); doAdd(cpu, *m); }
+#define SBC(e, w) { load(e, w); doSub(cpu, *m); }
+#define AND(e, w) { load(e, w); acc &= *m; setNZ(acc); }
+#define EOR(e, w) { load(e, w); acc ^= *m; setNZ(acc); }
+#define ORA(e, w) { load(e, w); acc |= *m; setNZ(acc); }
+
+#define LDA(e, w) { load(e, w); acc  = *m; setNZ(acc);  }
+#define LDX(e, w) { load(e, w); xreg = *m; setNZ(xreg); }
+#define LDY(e, w) { load(e, w); yreg = *m; setNZ(yreg); }
+#define STA(e, w) { uint8_t *m = (e); store(m, acc, w);  }
+#define STX(e, w) { uint8_t *m = (e); store(m, xreg, w); }
+#define STY(e, w) { uint8_t *m = (e); store(m, yreg, w); }
+
+#define compare(reg, e, w) { load(e, w); zres = (reg) - *m; \
+  cflag = zres < 0; nres = cflag*sign; }
+#define CMP(e, w) compare(acc,  e, w)
+#define CPX(e, w) compare(xreg, e, w)
+#define CPY(e, w) compare(yreg, e, w)
+
+/* read-modify-write instructions change a copy of the byte in memory,
+ * the acc versions work on acc itself
+ */
+#define modify(e, f, w) { uint8_t *m = (e); int n = *m; watchRead(m, w); f(n); store(m, n, w); }
+
+#define decNZ(n) dec(n); setNZ(n)
+#define incNZ(n) inc(n); setNZ(n)
+#define shiftL(n) n *= 2; setC(n >= BYTE_MAX); n &= BYTE_MASK; setNZ(n)
+#define shiftR(n) setC(n & carry); n /= 2; setNZ(n)
+#define rotL(n) n = n*2 + getC(); setC(n >= BYTE_MAX); n &= BYTE_MASK; setNZ(n)
+#define rotR(n) n += 2*getC()*BIT7_MASK; setC(n & carry); \
+  n /= 2; n &= BYTE_MASK; setNZ(n)
+
+#define DEC(e, w) modify(e, decNZ, w)
+#define INC(e, w) modify(e, incNZ, w)
+#define ASL(e, w) modify(e, shiftL, w)
+#define LSR(e, w) modify(e, shiftR, w)
+#define ROL(e, w) modify(e, rotL, w)
+#define ROR(e, w) modify(e, rotR, w)
+
+#define BIT(e, w) { load(e, w); zres = !(*m & acc); \
+  nres = *m; vflag = !!(*m & BIT6_MASK); }
+
+/* a branch taken takes one more cycle, two if it's to another page
+ */
+#define branch(cond, e) if (cond) { int from = getHigh(pc); \
+  relJmp(pc, *(e)); cpu->sim.cycles += 1 + (getHigh(pc) != from); }
+#define BCC(e, w) branch(!getC(), e)
+#define BCS(e, w) branch(getC(), e)
+#define BEQ(e, w) branch(!zres, e)
+#define BNE(e, w) branch(zres, e)
+#define BMI(e, w) branch(nres & sign, e)
+#define BPL(e, w) branch(!(nres & sign), e)
+#define BVC(e, w) branch(!vflag, e)
+#define BVS(e, w) branch(vflag, e); setC(0)
+
+#define JMP(e, w) pc = (e) - memory
+#define JSR(e, w) pushStack(cpu, getHigh(pc)); pushStack(cpu, getLow(pc)); JMP(e, w)
+#define RTS pc = popStack(cpu); pc += BYTE_MAX*popStack(cpu)
+
+OP(adc_abs, 3, EA_abs, ADC)
+OP(adc_abx, 3, EA_abxp, ADC)
+OP(adc_aby, 3, EA_abyp, ADC)
+OP(adc_imm, 2, EA_imm, ADC)
+OP(adc_izp, 2, EA_izp, ADC)
+OP(adc_izx, 2, EA_izx, ADC)
+OP(adc_zp, 2, EA_zp, ADC)
+OP(adc_zpx, 2, EA_zpx, ADC)
+
+OP(and_abs, 3, EA_abs, AND)
+OP(and_abx, 3, EA_abxp, AND)
+OP(and_aby, 3, EA_abyp, AND)
+OP(and_imm, 2, EA_imm, AND)
+OP(and_izpx, 2, EA_izpx, AND)
+OP(and_izx, 2, EA_izx, AND)
+OP(and_izy, 2, EA_izyp, AND)
+OP(and_zp, 2, EA_zp, AND)
+
+OP(asl_abs, 3, EA_abs, ASL)
+OP(asl_abx, 3, EA_abx, ASL)
+OP(asl_zp, 2, EA_zp, ASL)
+OP(asl_zpx, 2, EA_zpx, ASL)
+
+OP(bcc_rel, 2, EA_rel, BCC)
+
+OP(bcs_rel, 2, EA_rel, BCS)
+
+OP(beq_rel, 2, EA_rel, BEQ)
+
+OP(bit_abs, 3, EA_abs, BIT)
+OP(bit_zp, 2, EA_zp, BIT)
+
+OP(bmi_rel, 2, EA_rel, BMI)
+
+OP(bne_rel, 2, EA_rel, BNE)
+
+OP(bpl_rel, 2, EA_rel, BPL)
+
+OP(bvc_rel, 2, EA_rel, BVC)
+
+OP(bvs_rel, 2, EA_rel, BVS)
+
+OP(cmp_abs, 3, EA_abs, CMP)
+OP(cmp_abx, 3, EA_abxp, CMP)
+OP(cmp_aby, 3, EA_abyp, CMP)
+OP(cmp_imm, 2, EA_imm, CMP)
+OP(cmp_izx, 2, EA_izx, CMP)
+OP(cmp_izy, 2, EA_izyp, CMP)
+OP(cmp_zp, 2, EA_zp, CMP)
+OP(cmp_zpx, 2, EA_zpx, CMP)
+
+OP(cpx_abs, 3, EA_abs, CPX)
+OP(cpx_imm, 2, EA_imm, CPX)
+OP(cpx_zp, 2, EA_zp, CPX)
+
+OP(cpy_abs, 3, EA_abs, CPY)
+OP(cpy_imm, 2, EA_imm, CPY)
+OP(cpy_zp, 2, EA_zp, CPY)
+
+OP(dec_abs, 3, EA_abs, DEC)
+OP(dec_abx, 3, EA_abx, DEC)
+OP(dec_zp, 2, EA_zp, DEC)
+OP(dec_zpx, 2, EA_zpx, DEC)
+
+OP(eor_abs, 3, EA_abs, EOR)
+OP(eor_abx, 3, EA_abxp, EOR)
+OP(eor_aby, 3, EA_abyp, EOR)
+OP(eor_imm, 2, EA_imm, EOR)
+OP(eor_izx, 2, EA_izx, EOR)
+OP(eor_izy, 2, EA_izyp, EOR)
+OP(eor_zp, 2, EA_zp, EOR)
+OP(eor_zpx, 2, EA_zpx, EOR)
+
+OP(inc_abs, 3, EA_abs, INC)
+OP(inc_abx, 3, EA_abx, INC)
+OP(inc_zp, 2, EA_zp, INC)
+OP(inc_zpx, 2, EA_zpx, INC)
+
+OP(jmp_abs, 3, EA_abs, JMP)
+OP(jmp_ind, 3, EA_ind, JMP)
+
+OP(jsr_abs, 3, EA_abs, JSR)
+
+OP(lda_abs, 3, EA_abs, LDA)
+OP(lda_abx, 3, EA_abxp, LDA)
+OP(lda_aby, 3, EA_abyp, LDA)
+OP(lda_imm, 2, EA_imm, LDA)
+OP(lda_izx, 2, EA_izx, LDA)
+OP(lda_izy, 2, EA_izyp, LDA)
+OP(lda_zp, 2, EA_zp, LDA)
+OP(lda_zpx, 2, EA_zpx, LDA)
+
+OP(ldx_abs, 3, EA_abs, LDX)
+OP(ldx_aby, 3, EA_abyp, LDX)
+OP(ldx_imm, 2, EA_imm, LDX)
+OP(ldx_zp, 2, EA_zp, LDX)
+OP(ldx_zpy, 2, EA_zpy, LDX)
+
+OP(ldy_abs, 3, EA_abs, LDY)
+OP(ldy_abx, 3, EA_abxp, LDY)
+OP(ldy_imm, 2, EA_imm, LDY)
+OP(ldy_zpx, 2, EA_zpx, LDY)
+
+OP(lsr_abs, 3, EA_abs, LSR)
+OP(lsr_abx, 3, EA_abx, LSR)
+OP(lsr_zp, 2, EA_zp, LSR)
+OP(lsr_zpx, 2, EA_zpx, LSR)
+
+OP(ora_abs, 3, EA_abs, ORA)
+OP(ora_abx, 3, EA_abxp, ORA)
+OP(ora_aby, 3, EA_abyp, ORA)
+OP(ora_imm, 2, EA_imm, ORA)
+OP(ora_izx, 2, EA_izx, ORA)
+OP(ora_izy, 2, EA_izyp, ORA)
+OP(ora_zp, 2, EA_zp, ORA)
+OP(ora_zpx, 2, EA_zpx, ORA)
+
+OP(rol_abs, 3, EA_abs, ROL)
+OP(rol_aby, 3, EA_aby, ROL)
+OP(rol_izpx, 2, EA_izpx, ROL)
+OP(rol_zp, 2, EA_zp, ROL)
+
+OP(ror_abs, 3, EA_abs, ROR)
+OP(ror_abx, 3, EA_abx, ROR)
+OP(ror_zp, 2, EA_zp, ROR)
+
+OP(sbc_abs, 3, EA_abs, SBC)
+OP(sbc_abx, 3, EA_abxp, SBC)
+OP(sbc_aby, 3, EA_abyp, SBC)
+OP(sbc_imm, 2, EA_imm, SBC)
+OP(sbc_izx, 2, EA_izx, SBC)
+OP(sbc_izy, 2, EA_izyp, SBC)
+OP(sbc_zp, 2, EA_zp, SBC)
+OP(sbc_zpx, 2, EA_zpx, SBC)
+
+OP(sta_abs, 3, EA_abs, STA)
+OP(sta_abx, 3, EA_abx, STA)
+OP(sta_aby, 3, EA_aby, STA)
+OP(sta_izx, 2, EA_izx, STA)
+OP(sta_izy, 2, EA_izy, STA)
+OP(sta_zp, 2, EA_zp, STA)
+OP(sta_zpx, 2, EA_zpx, STA)
+
+OP(stx_abs, 3, EA_abs, STX)
+OP(stx_zp, 2, EA_zp, STX)
+OP(stx_zpy, 2, EA_zpy, STX)
+
+OP(sty_abs, 3, EA_abs, STY)
+OP(sty_zp, 2, EA_zp, STY)
+OP(sty_zpx, 2, EA_zpx, STY)
+
+OP0(asl_acc, shiftL(acc))
+OP0(lsr_acc, shiftR(acc))
+OP0(rol_acc, rotL(acc))
+OP0(ror_acc, rotR(acc))
+
+OP0(clc_imp, setC(0))
+OP0(cld_imp, setP(0, bcd))
+/* an irq held while I was set is taken by syncEvents() after the
+ * instruction that clears it, execBlock() stops there
+ */
+#define unmasked() if (cpu->irq_held) cpu->sim.next_event = 0
+
+OP0(cli_imp, setP(0, intr); unmasked())
+OP0(clv_imp, setP(0, bcd))
+OP0(sec_imp, setC(1))
+OP0(sed_imp, setP(1, bcd))
+OP0(sei_imp, setP(1, intr))
+
+OP0(dex_imp, dec(xreg); setNZ(xreg))
+OP0(dey_imp, dec(yreg); setNZ(yreg))
+OP0(inx_imp, inc(xreg); setNZ(xreg))
+OP0(iny_imp, inc(yreg); setNZ(yreg))
+
+OP0(tax_imp, xreg = acc;  setNZ(xreg))
+OP0(tay_imp, yreg = acc;  setNZ(yreg))
+OP0(txa_imp, acc  = xreg; setNZ(acc))
+OP0(tya_imp, acc  = yreg; setNZ(acc))
+OP0(tsx_imp, xreg = sp;   setNZ(xreg))
+OP0(txs_imp, sptr = xreg; setNZ(xreg))
+
+OP0(pha_imp, pushStack(cpu, acc))
+OP0(php_imp, storeP(); pushStack(cpu, psr))
+OP0(pla_imp, acc = popStack(cpu); setNZ(acc))
+OP0(plp_imp, psr = popStack(cpu); loadP(); unmasked())
+
+OP0(rti_imp, psr = popStack(cpu); loadP(); unmasked(); RTS)
+OP0(rts_imp, RTS)
+
+/* brk has never been executed by the simulator, the brk case of the
+ * old switch was shadowed by the brk status bit define above
+ */
+OP0(brk_imp, )
+OP0(nop_imp, )
+
+/* handler for each opcode, without and with watches
+ */
+#define H(name) { name, name##_w }
+static void (*const exec_table[BYTE_MAX][2])(cpu_ctx*, const uop_struct*) = 
+{
+  H(brk_imp), H(ora_izx), H(nop_imp), H(nop_imp), H(nop_imp), H(ora_zp), H(asl_zp), H(nop_imp),
+  H(php_imp), H(ora_imm), H(asl_acc), H(nop_imp), H(nop_imp), H(ora_abs), H(asl_abs), H(nop_imp),
+  H(bpl_rel), H(ora_izy), H(nop_imp), H(nop_imp), H(nop_imp), H(ora_zpx), H(asl_zpx), H(nop_imp),
+  H(clc_imp), H(ora_aby), H(nop_imp), H(nop_imp), H(nop_imp), H(ora_abx), H(asl_abx), H(nop_imp),
+  H(jsr_abs), H(and_izx), H(nop_imp), H(nop_imp), H(bit_zp), H(and_zp), H(rol_zp), H(nop_imp),
+  H(plp_imp), H(and_imm), H(rol_acc), H(nop_imp), H(bit_abs), H(and_abs), H(rol_abs), H(nop_imp),
+  H(bmi_rel), H(and_izy), H(nop_imp), H(nop_imp), H(nop_imp), H(and_izpx), H(rol_izpx), H(nop_imp),
+  H(sec_imp), H(and_aby), H(nop_imp), H(nop_imp), H(nop_imp), H(and_abx), H(rol_aby), H(nop_imp),
+  H(rti_imp), H(eor_izx), H(nop_imp), H(nop_imp), H(nop_imp), H(eor_zp), H(lsr_zp), H(nop_imp),
+  H(pha_imp), H(eor_imm), H(lsr_acc), H(nop_imp), H(jmp_abs), H(eor_abs), H(lsr_abs), H(nop_imp),
+  H(bvc_rel), H(eor_izy), H(nop_imp), H(nop_imp), H(nop_imp), H(eor_zpx), H(lsr_zpx), H(nop_imp),
+  H(cli_imp), H(eor_aby), H(nop_imp), H(nop_imp), H(nop_imp), H(eor_abx), H(lsr_abx), H(nop_imp),
+  H(rts_imp), H(adc_izx), H(nop_imp), H(nop_imp), H(nop_imp), H(adc_zp), H(ror_zp), H(nop_imp),
+  H(pla_imp), H(adc_imm), H(ror_acc), H(nop_imp), H(jmp_ind), H(adc_abs), H(ror_abs), H(nop_imp),
+  H(bvs_rel), H(adc_izp), H(nop_imp), H(nop_imp), H(nop_imp), H(adc_zpx), H(adc_zpx), H(nop_imp),
+  H(sei_imp), H(adc_aby), H(nop_imp), H(nop_imp), H(nop_imp), H(adc_abx), H(ror_abx), H(nop_imp),
+  H(nop_imp), H(sta_izx), H(nop_imp), H(nop_imp), H(sty_zp), H(sta_zp), H(stx_zp), H(nop_imp),
+  H(dey_imp), H(nop_imp), H(txa_imp), H(nop_imp), H(sty_abs), H(sta_abs), H(stx_abs), H(nop_imp),
+  H(bcc_rel), H(sta_izy), H(nop_imp), H(nop_imp), H(sty_zpx), H(sta_zpx), H(stx_zpy), H(nop_imp),
+  H(tya_imp), H(sta_aby), H(txs_imp), H(nop_imp), H(nop_imp), H(sta_abx), H(nop_imp), H(nop_imp),
+  H(ldy_imm), H(lda_izx), H(ldx_imm), H(nop_imp), H(ldy_imm), H(lda_zp), H(ldx_zp), H(nop_imp),
+  H(tay_imp), H(lda_imm), H(tax_imp), H(nop_imp), H(ldy_abs), H(lda_abs), H(ldx_abs), H(nop_imp),
+  H(bcs_rel), H(lda_izy), H(nop_imp), H(nop_imp), H(ldy_zpx), H(lda_zpx), H(ldx_zpy), H(nop_imp),
+  H(clv_imp), H(lda_aby), H(tsx_imp), H(nop_imp), H(ldy_abx), H(lda_abx), H(ldx_aby), H(nop_imp),
+  H(cpy_imm), H(cmp_izx), H(nop_imp), H(nop_imp), H(cpy_zp), H(cmp_zp), H(dec_zp), H(nop_imp),
+  H(iny_imp), H(cmp_imm), H(dex_imp), H(nop_imp), H(cpy_abs), H(cmp_abs), H(dec_abs), H(nop_imp),
+  H(bne_rel), H(cmp_izy), H(nop_imp), H(nop_imp), H(nop_imp), H(cmp_zpx), H(dec_zpx), H(nop_imp),
+  H(cld_imp), H(cmp_aby), H(nop_imp), H(nop_imp), H(nop_imp), H(cmp_abx), H(dec_abx), H(nop_imp),
+  H(cpx_imm), H(sbc_izx), H(nop_imp), H(nop_imp), H(cpx_zp), H(sbc_zp), H(inc_zp), H(nop_imp),
+  H(inx_imp), H(sbc_imm), H(nop_imp), H(nop_imp), H(cpx_abs), H(sbc_abs), H(inc_abs), H(nop_imp),
+  H(beq_rel), H(sbc_izy), H(nop_imp), H(nop_imp), H(nop_imp), H(sbc_zpx), H(inc_zpx), H(nop_imp),
+  H(sed_imp), H(sbc_aby), H(nop_imp), H(nop_imp), H(nop_imp), H(sbc_abx), H(inc_abx), H(nop_imp),
+
+};
+
+/* decode the instruction at addr for its handler
+ */
+static void decode(cpu_ctx *cpu, int addr, uop_struct *u)
+{
+  int op = memory[addr], bytes = cpu_instr_tkn[op][INSTR_TKN_BYTES];
+
+  u->exec = exec_table[op][cpu->sim.watching != 0];
+  u->cycles = cpu_instr_tkn[op][INSTR_TKN_CYCLES];
+  u->left = 0;
+  u->code = memory + addr + 1;
+  u->ea = memory;
+  if (addr + bytes>MEMORY_MAX) return; /* handler will report pc overflow */
+  if (bytes>1) u->ea += u->code[0];
+  if (bytes>2) u->ea += u->code[1]*BYTE_MAX;
+}
+
+/* step() is the master function to update the registers and memory 
+ * from the execution of the opcode at memory[pc]
+ */
+void step(sim_ctx *s)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  uop_struct u;
+  decode(cpu, pc, &u);
+  cpu->sim.cycles += u.cycles;
+  loadP();
+  u.exec(cpu, &u);
+  storeP();
+}
+
+/* the 6502 has no peripherals, events only request interrupts. An irq
+ * requested while I is set is held, as its line would be, until it can
+ * be taken. Either way it changes the cpu outside of the undo log
+ */
+void syncEvents(sim_ctx *s)
 {
-  int dlo, dhi;
-  if (psr & bcd)
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  event_struct e;
+
+  while (dueEvent(s, &e))
     {
-      dlo = (acc & LO_NYBLE) - (value & LO_NYBLE) - !getC();
-      dhi = (acc & HI_NYBLE) - (value & HI_NYBLE) - (dlo<0);
-      if (dlo<0) dlo += 10;
-      setP(dhi < 0, carry);
-      if (dhi<0) dlo += 10;
-      acc = dlo + 10*dhi;
+      if (e.kind != EVENT_IRQ) continue;
+      if (!irq(s, e.value)) cpu->irq_held = TRUE;
+      ++s->irq_gen;
     }
-  else
+  if (cpu->irq_held && irq(s, 0))
     {
-      acc -= value + !getC();
-      setP(acc < 0, carry);
-      acc &= BYTE_MASK;
+      cpu->irq_held = FALSE;
+      ++s->irq_gen;
     }
-  setP(acc & sign, sign);
-  setP(((acc & BIT7_MASK) != 0) ^ ((acc & BIT6_MASK) != 0), ov);
-  setP(!acc, zero);
+  s->next_event = firstEvent(s);
 }
 
-/* getParam will interpet the parameters of an opcode from
- * the entry in cpu_instr_tkn. It returns a pointer to the 
- * parameter either in memory, or the register
+/* an nmi is always taken, an irq only if it is not masked
  */
-static int *getParam(int op, const int **index, int **code)
+int canInterrupt(sim_ctx *s)
 {
-  int *ret, *addr = memory;
-  
-  while (**index)
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  const event_struct *e;
+  int i, n;
+
+  if (cpu->irq_held && !(psr & intr)) return TRUE;
+  for (e = getEvents(s, &n), i = 0; i<n; ++i)
+    if (e[i].kind == EVENT_IRQ && (e[i].value || !(psr & intr))) return TRUE;
+  return FALSE;
+}
+
+/* the 6502 has no serial port
+ */
+int setSerial(sim_ctx *s, int out, int in)
+{
+  return FALSE;
+}
+
+void flushSerial(sim_ctx *s)
+{
+}
+
+/* the stores of the instruction are saved by logged(). The only error
+ * of step() is a pc overflow before anything is stored, cpu->log is
+ * not set then, so it can't be left behind by the longjmp
+ */
+void logStep(sim_ctx *s, undo_rec *r)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+
+  r->pc_addr = pc;
+  r->cycles = s->cycles;
+  r->regs[0] = acc; r->regs[1] = xreg; r->regs[2] = yreg; 
+  r->regs[3] = sptr; r->regs[4] = psr;
+  r->num = 0;
+  if (pc + cpu_instr_tkn[memory[pc]][INSTR_TKN_BYTES]<MEMORY_MAX) cpu->log = r;
+  step(s);
+  cpu->log = NULL;
+}
+
+void undoStep(sim_ctx *s, const undo_rec *r)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  int i;
+
+  for (i = r->num - 1; i>=0; --i)
+    {
+      memory[r->where[i]] = r->old[i];
+      codeWrite(s, r->where[i]);
+    }
+  acc = r->regs[0]; xreg = r->regs[1]; yreg = r->regs[2];
+  sptr = r->regs[3]; psr = r->regs[4];
+  pc = r->pc_addr;
+  s->cycles = r->cycles;
+}
+
+/* jmp to its own address
+ */
+int isHalt(sim_ctx *s, int addr)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+
+  if (addr<0 || addr + 3>MEMORY_MAX || memory[addr] != 0x4C) return FALSE;
+  return memory[addr + 1] + memory[addr + 2]*BYTE_MAX == addr;
+}
+
+/* return the kind of loop of block b or 0. A delay loop is dex or dey
+ * followed by bne to its start. A poll loop only loads, compares or
+ * masks registers with memory and branches back on a flag, it does
+ * not store anything.
+ */
+static int loopKind(cpu_ctx *cpu, const block_struct *b)
+{
+  int i, addr = b->start, op = UNDEF, target = b->end;
+
+  if (b->num == 1 && isHalt(&cpu->sim, b->start)) return LOOP_POLL;
+  if (b->num>LOOP_MAX) return 0;
+  for (i = 0; i<b->num - 1; ++i)
     {
-      switch (**index)
+      op = memory[addr];
+      switch (cpu_instr_tkn[op][INSTR_TKN_INSTR])
 	{
-	case 0:
-	case rightPar:
-	  return addr;
-	  break;
-	case pound:
-	  ++*index;
-	case rel_addr:
-	case data_8:
-	  return *code;   /* return pointer to code for value */
-	  break;
-	case comma:       /* skip */
-	  break;
-	case a:
-	  return &acc;    /* return pointer to acc */
-	  break;
-	case x:
-	  addr += xreg;   /* x reg param is always added to address */
-	  break;
-	case y:
-	  addr += yreg;   /* y reg param is always added to address */
-	  break;
-	case addr_16:     /* get 16 bit address from code */
-	  addr += **code;          ++*code;
-	  addr += **code*BYTE_MAX; ++*code;
-	  break;
-	case addr_8:      /* get 8 bit address from code */
-	  addr += **code; ++*code;
-	  break;
-	case leftPar:
-	  /* Make recursive call to getParam to evaluate param 
-	   * inside ()'s. The address is derefenced to get the
-	   * address to the parameter value
-	   *
-	   * param value is 8-bit except for jmp (addr_16)
-	   */
-	  ret = getParam(op, index, code);
-	  addr += *ret;
-	  if (cpu_instr_tkn[op][INSTR_TKN_INSTR] == jmp)
-	    addr += *(ret + 1)*BYTE_MAX;
+	case lda: case ldx: case ldy: case bit: case cmp: case cpx: case cpy:
+	case and: case ora: case eor: case nop: case dex: case dey:
 	  break;
 	default:
-	  assert(TRUE);
+	  return 0;
 	  break;
 	}
-      ++*index;
+      addr += cpu_instr_tkn[op][INSTR_TKN_BYTES];
     }
-  return addr;
+  switch (cpu_instr_tkn[memory[addr]][INSTR_TKN_INSTR])
+    {
+    case bcc: case bcs: case beq: case bmi: case bne: case bpl: case bvc: case bvs:
+      relJmp(target, memory[addr + 1]);
+      if (target != b->start) return 0;
+      break;
+    default:
+      return 0;
+      break;
+    }
+  if (b->num == 2 && (op == 0xCA || op == 0x88)) /* dex or dey */
+    return (memory[addr] == 0xD0) ? LOOP_DELAY : 0;
+  for (i = 0, addr = b->start; i<b->num - 1; ++i)
+    {
+      if (memory[addr] == 0xCA || memory[addr] == 0x88) return 0;
+      addr += cpu_instr_tkn[memory[addr]][INSTR_TKN_BYTES];
+    }
+  return LOOP_POLL;
 }
 
-/* step() is the master function to update the registers and memory 
- * from the execution of the opcode at memory[pc]
+/* decode the instructions of block b for execBlock()
  */
-void step(void)
+void buildBlock(sim_ctx *s, block_struct *b)
 {
-  int op = memory[pc], *code = memory + pc + 1,
-    opcode = cpu_instr_tkn[op][INSTR_TKN_INSTR], n, *param, 
-    *reg = instrReg_table[opcode - PROC_TOKEN];
-  const int *index = cpu_instr_tkn[op] + INSTR_TKN_PARAM;
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  uop_struct *u = b->code;
+  int i, addr = b->start;
+
+  safeRealloc(u, uop_struct, b->num);
+  for (i = 0; i<b->num; ++i)
+    {
+      decode(cpu, addr, u + i);
+      addr += cpu_instr_tkn[memory[addr]][INSTR_TKN_BYTES];
+    }
+  for (i = b->num - 1, addr = 0; i>=0; --i)
+    {
+      u[i].left = addr;
+      addr += u[i].cycles;
+    }
+  b->code = u;
+  b->loop = loopKind(cpu, b);
+}
 
-  /* value of pc during instr execution is pc of next instr
-   * return immediately if pc has overflowed (let sim register error)
-   */  
-  pc += cpu_instr_tkn[memory[pc]][INSTR_TKN_BYTES];
-  if (pc>=MEMORY_MAX) { pc = 0; longjmp(err, pc_overflow); }
+/* execute the instructions of block b. Stop early, if the block itself
+ * has been invalidated by a store to code memory, a watch was hit or
+ * a held irq can be taken
+ */
+int execBlock(sim_ctx *s, block_struct *b)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  const uop_struct *u = b->code, *end = u + b->num;
+  int n;
 
-  /* evaluate op parameters and return pointer to its value
-   */
-  param = getParam(op, &index, &code);
-  switch (opcode)
+  cpu->sim.cycles += b->cycles;
+  loadP();
+  while (u<end)
     {
-    case adc: /* add memory location with carry to accumulator */
-      doAdd(*param);
-      break;
-    case and: /* and memory location with accumultor */
-      acc &= *param;
-      setP(acc & sign, sign);
-      setP(!acc, zero);
-      break;
-    case asl: /* arithmatic shift memory location or accumulator left */
-      *param *= 2;
-      setP(*param >= BYTE_MAX, carry);
-      *param &= BYTE_MASK;
-      setP(*param & sign, sign);
-      setP(!*param, zero);
-      break;
-    case bcc: /* branch if carry clear */
-      if (!getC()) relJmp(pc, *param);
-      break;
-    case bcs: /* branch if carry set */
-      if (getC()) relJmp(pc, *param);
-      break;
-    case beq: /* branch if zero */
-      if (psr & zero) relJmp(pc, *param);
-      break;
-    case bit: /* bit test memory location */
-      setP(*param & acc, zero);
-      setP(*param & BIT7_MASK, sign);
-      setP(*param & BIT6_MASK, ov);
-      break;
-    case bmi: /* branch if negative */
-      if (psr & sign) relJmp(pc, *param);
-      break;
-    case bne: /* branch if not equal */
-      if (!(psr & zero)) relJmp(pc, *param);
-      break;
-    case bpl: /* branch if positive */
-      if (!(psr & sign)) relJmp(pc, *param);
-      break;
-    case brk: /* force break */
-      if (psr & intr) return; /* don't break in middle of interrupt */
-      setP(1, brk);
-      pushStack(getHigh(pc));
-      pushStack(getLow(pc));
-      pushStack(p);
-      setP(1, intr);
-      pc = memory[IRQ] + memory[IRQ + 1]*BYTE_MAX;
-      break;
-    case bvc: /* branch if overflow clear */
-      if (!(psr & ov)) relJmp(pc, *param);
-      break;
-    case bvs: /* branch if overflow set */
-      if (psr & ov) relJmp(pc, *param);
-    case clc: /* clear carry */
-      setC(0);
-      break;
-    case cld: /* clear bcd mask */
-      setP(0, bcd);
-      break;
-    case cli: /* clear interrupt mask (enable interrupts) */
-      setP(0, intr);
-      break;
-    case clv: /* clear overflow mask */
-      setP(0, bcd);
-      break;
-    case cmp: /* compare memory and accumulator */ 
-    case cpx: /* compare memory and x register */ 
-    case cpy: /* compare memory and y register */ 
-      n = *reg - *param;
-      setP(n & 2*BIT7_MASK, sign);
-      setP(!n, zero);
-      setP(n < 0, carry);
-      break;
-    case dec: /* decrease memory location */
-      reg = param;
-    case dex: /* decrease x register */
-    case dey: /* decrease y register */
-      dec(*reg);
-      setP(*reg & sign, sign);
-      setP(!*reg, zero);
-      break;
-    case eor: /* exclusive or accumulator and memory */
-      acc = acc ^ *param;
-      setP(acc & sign, sign);
-      setP(!acc, zero);
-      break;
-    case inc: /* increase memory location */
-      reg = param;
-    case inx: /* increase x register */
-    case iny: /* increase y register */
-      inc(*reg);
-      setP(*reg & sign, sign);
-      setP(!*reg, zero);
-      break;
-    case jsr: /* subroutine call to address */
-      pushStack(getHigh(pc));
-      pushStack(getLow(pc));
-    case jmp: /* param has address of memory location to be executed next */
-      pc = param - memory;
-      break;
-    case lda: /* load accumulator from memory */
-    case ldx: /* load x register  from memory */
-    case ldy: /* load y register  from memory */
-      *reg = *param;
-      setP(*reg & sign, sign);
-      setP(!*reg, zero);
-      break;
-    case lsr: /* logical shift right of accumulator or memory location */
-      setC(*param & carry);
-      *param /= 2;
-      setP(*param & sign, sign);
-      setP(!*param, zero);
-      break;
-    case nop: case NOP: /* no operation */
-      break;
-    case ora: /* logically or memory with accumulator */
-      acc |= *param;
-      setP(acc & sign, sign);
-      setP(!acc, zero);
-      break;
-    case pha: /* push accumulator onto stack */
-    case php: /* push status reg  onto stack */
-      pushStack(*reg);
-      break;
-    case pla: /* push accumulator from stack */
-      acc = popStack();
-      setP(acc & sign, sign);
-      setP(!acc, zero);
-      break;
-    case plp: /* push status reg  from stack */
-      psr = popStack();
-      break;
-    case rol: /* rotate memory or accumulator left through carry */
-      *param = *param*2 + getC();
-      setC(*param>=BYTE_MAX);
-      *param &= BYTE_MASK;
-      setP(*param & sign, sign);
-      setP(!*param, zero);
-      break;
-    case ror: /* rotate memory or accumulator right through carry */
-      *param += 2*getC()*BIT7_MASK;
-      setC(*param & carry);
-      *param /= 2;
-      *param &= BYTE_MASK;
-      setP(*param & sign, sign);
-      setP(!*param, zero);
-      break;
-    case rti:
-      psr = popStack();
-    case rts:
-      pc = popStack() + BYTE_MAX*popStack();
-      break;
-    case sbc: /* subtract memory location with borrow from accumulator */
-      doSub(*param);
-      break;
-    case sec: /* set carry */
-      setC(1);
-      break;
-    case sed: /* set bcd mask */
-      setP(1, bcd);
-      break;
-    case sei: /* set interrupt mask (disable interrupts) */
-      setP(1, intr);
-      break;
-    case sta: /* store accumulator in memory */
-    case stx: /* store x register  in memory */
-    case sty: /* store y register  in memory */
-      *param = *reg;
-      break;
-    case tax: /* move accumulator into x register */
-    case tay: /* move accumulator into y register */
-      *reg = acc;
-      setP(*reg & sign, sign);
-      setP(!*reg, zero);
-      break;
-    case tsx: /* move stack pointer into x register */
-      xreg = sp;
-      setP(xreg & sign, sign);
-      setP(!xreg, zero);
-      break;
-    case txs: /* move x register into stack pointer */
-      sptr = xreg;
-      setP(xreg & sign, sign);
-      setP(!xreg, zero);
-      break;
-    case txa: /* move x register into accumulator */
-    case tya: /* move y register into accumulator */
-      acc = *reg;
-      setP(*reg & sign, sign);
-      setP(!*reg, zero);
-      break;
-    default:
-      assert(TRUE);
-      break;
+      u->exec(cpu, u);
+      ++u;
+      if (s->code_written || s->watch_hit || !s->next_event) break;
+    }
+  storeP();
+  n = u - (const uop_struct*) b->code;
+  while (u<end) cpu->sim.cycles -= (u++)->cycles; /* not executed */
+  return n;
+}
+
+/* a poll loop does not store, it is waiting if it leaves the registers
+ * as they were. A delay loop counts x or y down to 0 with N and Z set
+ * by the last dex or dey.
+ */
+int skipLoop(sim_ctx *s, block_struct *b, int count, unsigned long long limit)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  int regs[4] = { acc, xreg, yreg, psr }, *reg, done, times;
+  unsigned long long c = s->cycles;
+
+  if ((done = execBlock(s, b))<b->num || pc != b->start) return done;
+  c = s->cycles - c;
+  if (b->loop == LOOP_DELAY)
+    {
+      reg = (memory[b->start] == 0xCA) ? &xreg : &yreg;
+      times = loopTimes(s, b, c, count - done, limit);
+      if (times>*reg - 1) times = *reg - 1;
+      *reg -= times;
+      psr = (psr & (BYTE_MASK - sign - zero)) | (*reg & sign);
     }
-  return;
+  else if (acc == regs[0] && xreg == regs[1] && yreg == regs[2] && psr == regs[3])
+    times = loopTimes(s, b, c, count - done, limit);
+  else
+    return done;
+  s->cycles += times*c;
+  return done + times*b->num;
 }
 
 /* getRegister will return the address to the name of the register given it
  * if *bit not UNDEF, register is one bit in length
  */
-int *getRegister(str_storage name, int *bit, int *bytes)
+int *getRegister(sim_ctx *s, str_storage name, int *bit, int *bytes)
 {
+  cpu_ctx *cpu = (cpu_ctx*) s;
   int index;
   const str_storage *ret = bsearch(name, tokens, tokens_length, sizeof(str_storage), &cmpstr);
   if (!ret) return NULL;
@@ -457,21 +860,45 @@ int *getRegister(str_storage name, int *bit, int *bytes)
     }
 }
 
-/* getMemory() will return the value of the memor location addr. m is ignored
+/* getMemory() will return the value of the memory location addr.
+ * There is only code memory, m has to be '\0' or 'c'
  */
-int *getMemory(int addr, char m)
+int getMemory(sim_ctx *s, int addr, char m)
 {
-  if (m != '\0' && m != 'c') return NULL;
-  if (addr>=MEMORY_MAX) return NULL;
-  return memory + addr;
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  if (m != '\0' && m != 'c') return UNDEF;
+  if (addr<0 || addr>=MEMORY_MAX) return UNDEF;
+  return memory[addr];
+}
+
+/* setMemory() will store value at memory location addr
+ */
+int setMemory(sim_ctx *s, int addr, char m, int value)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  if (getMemory(s, addr, m) == UNDEF) return FALSE;
+  memory[addr] = value;
+  codeWrite(s, addr);
+  return TRUE;
+}
+
+/* all memory is in WATCH_MEM
+ */
+int watchArea(sim_ctx *s, int addr, char m, int *index, int *bit)
+{
+  if (getMemory(s, addr, m) == UNDEF) return UNDEF;
+  *index = addr;
+  *bit = BYTE_MASK;
+  return WATCH_MEM;
 }
 
 
 /* Dump all the memory in hex text format to file. 
  * Should be able to restart simulator with this file
  */
-void dumpMemory(FILE* fd)
+void dumpMemory(sim_ctx *s, FILE* fd)
 {
+  cpu_ctx *cpu = (cpu_ctx*) s;
   int i;
   
   fprintf(fd, " A: %02X, X: %02X, Y: %02X, SP: %02X, PS: %02X, PC: %04X\n", 
@@ -491,8 +918,9 @@ void dumpMemory(FILE* fd)
 
 /* Load the file into memory produced by dumpMemory
  */
-void restoreMemory(FILE* fd)
+void restoreMemory(sim_ctx *s, FILE* fd)
 {
+  cpu_ctx *cpu = (cpu_ctx*) s;
   int i;
   
   fscanf(fd, " A: %02X, X: %02X, Y: %02X, SP: %02X, PS: %02X, PC: %04X\n", 
@@ -502,13 +930,88 @@ void restoreMemory(FILE* fd)
   for (i=0; i<65536; i+=16)
     {
        fscanf(fd, "%*[a-fA-F0-9] "
-	      "%02X %02X %02X %02X %02X %02X %02X %02X "
-	      "%02X %02X %02X %02X %02X %02X %02X %02X\n", 
-	      (unsigned int*) memory + i, (unsigned int*) memory + i + 1, (unsigned int*) memory + i + 2, 
-	      (unsigned int*) memory + i + 3, (unsigned int*) memory + i + 4, (unsigned int*) memory + i + 5, 
-	      (unsigned int*) memory + i + 6, (unsigned int*) memory + i + 7, (unsigned int*) memory + i + 8, 
-	      (unsigned int*) memory + i + 9, (unsigned int*) memory + i + 10, (unsigned int*) memory + i + 11,
-	      (unsigned int*) memory + i + 12, (unsigned int*) memory + i + 13, (unsigned int*) memory + i + 14, 
-	      (unsigned int*) memory + i + 15);
+	      "%02hhX %02hhX %02hhX %02hhX %02hhX %02hhX %02hhX %02hhX "
+	      "%02hhX %02hhX %02hhX %02hhX %02hhX %02hhX %02hhX %02hhX\n", 
+	      memory + i, memory + i + 1, memory + i + 2, memory + i + 3,
+	      memory + i + 4, memory + i + 5, memory + i + 6, memory + i + 7,
+	      memory + i + 8, memory + i + 9, memory + i + 10, memory + i + 11,
+	      memory + i + 12, memory + i + 13, memory + i + 14, memory + i + 15);
     }
+  flushBlocks(s);
+}
+
+/* snapshot of a 6502 is its registers followed by memory. Code and
+ * data share it, so it is always saved
+ */
+typedef struct
+{
+  snap_header head;
+  uint8_t a, x, y, sp, ps, pad[3];
+} snap_6502;
+
+int saveSnap(sim_ctx *s, int fd, int code)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  snap_6502 snap;
+  struct iovec iov[2];
+
+  initSnap(&snap.head, s, "6502", sizeof(snap), SNAP_CODE);
+  snap.a = acc; snap.x = xreg; snap.y = yreg; snap.sp = sptr; snap.ps = psr;
+  memset(snap.pad, 0, sizeof(snap.pad));
+  iov[0].iov_base = &snap;
+  iov[0].iov_len = sizeof(snap);
+  iov[1].iov_base = memory;
+  iov[1].iov_len = MEMORY_MAX;
+  return writeSnap(fd, iov, 2);
+}
+
+/* map the 6502 snapshot in fd, see mapSnap()
+ */
+static snap_6502 *getSnap(int fd, size_t *len, int write)
+{
+  snap_6502 *snap = (snap_6502*) mapSnap(fd, "6502", len, write);
+
+  if (snap && (snap->head.size != sizeof(snap_6502) || *len != sizeof(snap_6502) + MEMORY_MAX))
+    {
+      unmapSnap(snap, *len);
+      return NULL;
+    }
+  return snap;
+}
+
+/* set registers of cpu from snapshot
+ */
+static void setSnap(cpu_ctx *cpu, const snap_6502 *snap)
+{
+  acc = snap->a; xreg = snap->x; yreg = snap->y; sptr = snap->sp; psr = snap->ps;
+  pc = snap->head.pc_addr;
+  cpu->sim.cycles = snap->head.cycles;
+}
+
+int loadSnap(sim_ctx *s, int fd)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  const snap_6502 *snap;
+  size_t len;
+
+  if (!(snap = getSnap(fd, &len, FALSE))) return FALSE;
+  setSnap(cpu, snap);
+  memcpy(memory, snap + 1, MEMORY_MAX);
+  unmapSnap(snap, len);
+  flushBlocks(s);
+  return TRUE;
+}
+
+sim_ctx *mapSim(int fd)
+{
+  cpu_ctx *cpu;
+  snap_6502 *snap;
+  size_t len;
+
+  if (!(snap = getSnap(fd, &len, TRUE))) return NULL;
+  cpu = (cpu_ctx*) newSim((uint8_t*) (snap + 1));
+  cpu->sim.snap = snap;
+  cpu->sim.snap_len = len;
+  setSnap(cpu, snap);
+  return &cpu->sim;
 }
@@ -27,6 +27,9 @@
 #include <assert.h>
 #include <signal.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <limits.h>
 
 #ifdef __WIN32__
 #include <io.h>
@@ -39,6 +42,11 @@
 #include "cpu.h"
 #include "err.h"
 #include "sim.h"
+#include "batch.h"
+#include "snap.h"
+#include "cover.h"
+#include "watch.h"
+#include "event.h"
 #include "version.h"
 
 const char asm_version[] = "Assembler " ASM_VERS 
@@ -192,26 +200,29 @@ static int nchar = 0;
  */
 enum simCmd
   {
-    brkln, brk_tmp, clr_brk, clr_dsp, go, intr, list_brk, list_dsp,
-    next,  print, pr_bin, pr_dec, pr_line, pr_led, pr_reg, pr_hex, 
-    quit, resume, resetSim, stpln, trace, lastCmd
+    brkln, brk_tmp, clr_brk, clr_dsp, clr_watch, coverage, go, intr, list_brk,
+    list_dsp, list_watch, next,  print, pr_bin, pr_dec, pr_line, pr_led, pr_reg,
+    pr_hex, profile, quit, resume, rev_cont, resetSim, rev_step, run_for, stpln,
+    trace, undo, lastCmd
   };
 
 /* array of simulator commands strings
  */
-#define NUM_SIM 26
+#define NUM_SIM 33
 static const str_storage simCmdStr[] =
   {
-    "b", "break", "bt",    "cb", "cd",    "g",    "i", "lb", "ld",
-    "n",  "next",  "p",    "pb", "pd",   "pl", "pled", "pr",
-    "px",    "q",  "r", "reset",  "s", "step",    "t", "trace"
+    "b", "break", "bt",    "cb", "cd", "cov", "cw",    "g",    "i", "lb", "ld",
+    "lw", "n",  "next",  "p",    "pb", "pd",   "pl", "pled", "pr", "prof",
+    "px",    "q",  "r", "rc", "reset", "rs", "run", "s", "step",  "t", "trace",
+    "undo"
   };
 
 static const int simCmd[] =
   {
-    brkln, brkln, brk_tmp, clr_brk, clr_dsp, go, intr, list_brk, list_dsp,
-    next, next, print, pr_bin, pr_dec, pr_line, pr_led, pr_reg,
-    pr_hex, quit, resume, resetSim, stpln, stpln, trace, trace
+    brkln, brkln, brk_tmp, clr_brk, clr_dsp, coverage, clr_watch, go, intr, list_brk,
+    list_dsp, list_watch, next, next, print, pr_bin, pr_dec, pr_line, pr_led, pr_reg,
+    profile, pr_hex, quit, resume, rev_cont, resetSim, rev_step, run_for, stpln, stpln, 
+    trace, trace, undo
   };
 
 /* simulator help by letter
@@ -222,7 +233,12 @@ static const str_storage sim_help[26] =
     "b  [line/$addr] [if expr] : break at line# or $addr (pc if not given) if expr is true\n"
     "bt [line/$addr] [if expr] : break will be cleared when hit\n",
     "cb [list] : clear break by number, or all if no params\n"
-    "cd [list] : clear display by number or all if no params\n",
+    "cd [list] : clear display by number or all if no params\n"
+    "cov on/off       : start recording the code executed with a cleared map or stop\n"
+    "cov              : print how many instructions and branch directions were executed\n"
+    "cov list [file]  : print the listing with the code executed to file or the screen\n"
+    "cov save file    : write the map of code executed to file (see sim --cover -h)\n"
+    "cw [list] : clear watch by number, or all if no params\n",
     "command will display corresponding print command after each\n"
     "execution of an instruction\n",
     0, 0, /* e, f help */
@@ -233,14 +249,17 @@ static const str_storage sim_help[26] =
     "addr       - address given by number or value of label\n"
     "$addr      - indirect address\n"
     "@          - get direct address of register\n"
+    "@cycles    - cycles executed since reset, stops at 2147483647\n"
+    "             (pr cycles prints all 64 bits)\n"
     "expr       - algebraic expression evaluated each time it is used\n"
     "list       - list of numbers or expressions seperated by a space\n"
     "[...]      - optional parameter\n"
     "[repeat]   - optional value to run cmd repeat times\n\n",
-    "i expr : request interrupt number expr\n",
+    "i expr [cycles] : request interrupt number expr now or after cycles\n",
     0, 0, /* j, k help */
     "lb [list] : list break number (expr), at addr or all if no param\n"
-    "ld [list] : list display number (expr) or all if no param given\n",
+    "ld [list] : list display number (expr) or all if no param given\n"
+    "lw [list] : list watch number or all if no param given\n",
     "m [@reg/addr:c] list : assign value(s) to memory or register addr\n"
     "m(c) addr list       : assign value(s) to memory location addr:c\n",
     "n [repeat]  : execute next instr, but skip over subroutine calls\n",
@@ -250,14 +269,36 @@ static const str_storage sim_help[26] =
     "pl   [list]           : print asm line at the given line numbers\n"
     "pm[c] addr [length]   : print memory at addr:c\n"
     "pled list             : print value of expression as LED\n"
-    "pr   list             : print list of registers (all if no params)\n"
+    "pr   list             : print list of registers (all if no params) or cycles\n"
+    "prof on/off           : start profiling with cleared counts or stop it.\n"
+    "                        Instructions are stepped one at a time while it is on\n"
+    "prof [n]              : print the n (default 10) lines and labels that took\n"
+    "                        the most cycles\n"
+    "prof list [file]      : print the listing with instructions and cycles of\n"
+    "                        each line to file or the screen\n"
+    "prof calls [n]        : print the n subroutines that took the most cycles,\n"
+    "                        with and without the ones they called\n"
+    "prof fold [file]      : print the cycles of each path of calls as folded\n"
+    "                        stacks for flame graph tools\n"
     "px   list             : print expression in hexadecimal\n",
     "q  : quit simmulator\n",
-    "r [repeat] : resume execution\n"
-    "reset      : reset state of simulator\n",
+    "r [repeat]  : resume execution\n"
+    "rc [repeat] : resume execution backwards to the last break (see undo)\n"
+    "reset       : reset state of simulator\n"
+    "rs [repeat] : step back one instruction (see undo)\n"
+    "run n [c]   : run n instructions (n cycles with c) without display and\n"
+    "              print the time it took\n",
     "s [repeat] : step one instruction\n",
     "t [repeat] : trace until break\n",
-    0, 0, 0, /* u, v, w help */
+    "undo [n] : keep the last n instructions executed for rs and rc (0 turns\n"
+    "           it off, the default). Without n, print the size of the log.\n"
+    "           Instructions are stepped one at a time while it is on\n",
+    0, /* v help */
+    "w addr[:c] [length] [rwc] : stop after an instruction that reads (r), writes (w)\n"
+    "                            or changes (c) memory at addr:c for length bytes\n"
+    "                            (default 1 byte written). A bit (c is b) is read\n"
+    "                            and written with its byte\n"
+    "w(c) addr [length] [rwc]  : watch memory location addr:c\n",
     0, 0, 0  /* x, y, z help */
   };
 
@@ -362,7 +403,7 @@ static int getAddrParam(int finalFlag)
 {
   int addr;
   char *s, *p = strtok(NULL, "\040\t");
-  if (!p) return pc;
+  if (!p) return sim->pc;
 
   if (!strcmp(p, "-"))
     addr = UNDEF;
@@ -436,6 +477,35 @@ int printOneBreak(FILE* fd, int n, brk_struct* b)
     return FALSE;
 }
 
+/* print watch number n as kinds of access, address and length
+ */
+static int printOneWatch(FILE *fd, int n, const watch_struct *w)
+{
+  int nc = fprintf(fd, "[%2d] Watch %s%s%s at $%04X", n, (w->kind & WATCH_READ) ? "r" : "",
+		   (w->kind & WATCH_WRITE) ? "w" : "", (w->kind & WATCH_CHANGE) ? "c" : "", w->addr);
+  if (w->m) nc += fprintf(fd, ":%c", w->m);
+  if (w->len>1) nc += fprintf(fd, ", %d bytes", w->len);
+  return nc;
+}
+
+/* print the access that hit the watch of sim. A bit is printed as such
+ */
+static int printWatchHit(FILE *fd)
+{
+  static const str_storage kinds[] = { "", "read", "written", "", "changed" };
+  const watch_event *e = getWatchEvent();
+  const watch_struct *w;
+  int num, nc;
+
+  w = getWatches(&num) + sim->watch_hit - 1;
+  nc = fprintf(fd, "Watch [%d] $%04X", sim->watch_hit, e->addr);
+  if (w->m) nc += fprintf(fd, ":%c", w->m);
+  if (w->bit != BYTE_MASK)
+    return nc + fprintf(fd, " %s %d -> %d", kinds[e->kind], (e->old & w->bit) != 0, (e->value & w->bit) != 0);
+  if (e->kind == WATCH_READ) return nc + fprintf(fd, " read %02X", e->value);
+  return nc + fprintf(fd, " %s %02X -> %02X", kinds[e->kind], e->old, e->value);
+}
+
 /* add break. If bare number, treat as assembly file number.
  * if '$' treat as code address
  */
@@ -443,7 +513,7 @@ static void doBrk(int tmpFlag)
 {
   char *e = NULL;
   int line, brk, addr = getAddrParam(FALSE);
-  if (memory[addr]<0) longjmp(err, dup_brk);
+  if (isBrk(sim, addr)) longjmp(err, dup_brk);
 
   if ((e = getStrParam(FALSE, FALSE)))
     {
@@ -473,6 +543,24 @@ static void doClrBrk()
   while ((brk = getNumParam(FALSE)) != UNDEF);
 }
 
+/* if no paramter, ask to clear all watches. Otherwise clear watches given
+ */
+static void doClrWatch()
+{
+  int n = getNumParam(FALSE);
+  if (n == UNDEF && answer("Clear all watches"))
+    {
+      delWatch(sim, UNDEF); return;
+    }
+  
+  do
+    { 
+      if (nchar) { printf(newLine); nchar = 0; }
+      if (!delWatch(sim, n)) printf("Warning: watch #%d does not exist\n", n);
+    }
+  while ((n = getNumParam(FALSE)) != UNDEF);
+}
+
 /* if no paramter, ask to clear all display commands
  * Otherwise clear all display commands
  */
@@ -522,12 +610,15 @@ static void display()
     }
 }
 
-/* break was hit, print a message to that effect
+/* break or watch was hit, print a message to that effect
  */
 static void dsp_brk(int line)
 {
   if (nchar) putchar('\n');
-  nchar = printf("Break at line %d", line);
+  if (sim->watch_hit)
+    nchar = printWatchHit(stdout) + printf(" at line %d", line);
+  else
+    nchar = printf("Break at line %d", line);
 }
 
 /* every display command has equiv print command.
@@ -568,12 +659,23 @@ static void doGo()
   if (addr != UNDEF) dsp_brk(asm_Lines[addr]);
   display();
 }
-/* execute interrupt. Parameter is processor depedent
+/* execute interrupt. Parameter is processor depedent. With a second
+ * parameter, the interrupt is requested by an event after that many
+ * cycles. It is not in the undo log either, see stepOne().
  */
 static void doIRQ()
 {
-  int irqno = getNumParam(TRUE);
-  int result = irq(irqno);
+  int irqno = getNumParam(FALSE), delay = getNumParam(TRUE), result;
+
+  if (irqno == UNDEF || !isIrq(sim, irqno)) longjmp(err, no_irq);
+  if (delay != UNDEF)
+    {
+      if (delay<0) longjmp(err, bad_param);
+      addEvent(sim, sim->cycles + delay, EVENT_IRQ, irqno);
+      return;
+    }
+  result = irq(sim, irqno);
+  if (result == TRUE) clearUndo(); /* interrupt is not in the undo log */
   if (!result) nchar += printf("Interrupt #%d was masked out", irqno);
   if (result == UNDEF) longjmp(err, no_irq);
 }
@@ -591,6 +693,26 @@ static void doListBrk()
   while ((brk = getNumParam(FALSE)) != UNDEF);
 }
 
+/* list the watches given or all of them
+ */
+static void doListWatch()
+{
+  const watch_struct *w;
+  int i, num, n = getNumParam(FALSE);
+
+  w = getWatches(&num);
+  do
+    {
+      for (i = 1; i<=num; ++i)
+	{
+	  if ((n != UNDEF && i != n) || !w[i - 1].used) continue;
+	  if (nchar) putchar('\n');
+	  nchar = printOneWatch(stdout, i, w + i - 1);
+	}
+    }
+  while ((n = getNumParam(FALSE)) != UNDEF);
+}
+
 /* print the display commands
  */
 static void doListDsp()
@@ -622,52 +744,100 @@ static void doListDsp()
 static void doMem(char c)
 {
   char *expr;
-  int *mem, addr, value;
+  int *reg = NULL, addr, value;
 
   if (c) 
     {
       addr = getNumParam(FALSE);
       if (addr  == UNDEF) longjmp(err, miss_param);
-      mem = getMemory(addr, c);
     }
   else
     {
       expr = getStrParam(TRUE, FALSE);
-      mem = getMemExpr(expr, &addr, &c);
+      if (!(reg = getMemExpr(expr, &addr, &c))) longjmp(err, bad_addr);
+      if (expr[0] != '@') reg = NULL; /* memory, not a register */
     }
 
   value = getNumParam(FALSE);
   if (value == UNDEF) longjmp(err, miss_param);
   do
     {
+      if (!reg && getMemory(sim, addr, c) == UNDEF) longjmp(err, bad_addr);
       if (value<SGN_BYTE_MIN || value>=BYTE_MAX)
 	printf("Warning: %s, masked to 8 bits\n", error_messages[out_range]);
-      *mem = value & BYTE_MASK; /* if negative, mask out leads 1's */
-      ++mem;
+
+      /* if negative, mask out leads 1's. Memory is written by the
+       * backend, it may be code
+       */
+      if (reg)
+	*reg++ = value & BYTE_MASK;
+      else
+	setMemory(sim, addr++, c, value & BYTE_MASK);
     }
   while ((value = getNumParam(FALSE)) != UNDEF);
 }
 
+/* add the watch given by the parameters addr:c [length] [rwc] or, if c
+ * is not 0, addr [length] [rwc]. Returns its number
+ */
+static int addWatchParam(char c)
+{
+  char *expr, *k;
+  int addr, length, kind = 0;
+
+  if (c) 
+    {
+      addr = getNumParam(FALSE);
+      if (addr  == UNDEF) longjmp(err, miss_param);
+    }
+  else
+    {
+      expr = getStrParam(TRUE, FALSE);
+      if (expr[0] == '@' || !getMemExpr(expr, &addr, &c)) longjmp(err, bad_addr);
+    }
+  length = getNumParam(FALSE);
+  if (!(k = getStrParam(FALSE, TRUE))) k = "w";
+  for (; *k; ++k)
+    {
+      switch (*k)
+	{
+	case 'r': kind |= WATCH_READ;   break;
+	case 'w': kind |= WATCH_WRITE;  break;
+	case 'c': kind |= WATCH_CHANGE; break;
+	default: longjmp(err, bad_param); break;
+	}
+    }
+  return addWatch(sim, c, addr, (length == UNDEF) ? 1 : length, kind);
+}
+
+/* add a watch and print it
+ */
+static void doWatch(char c)
+{
+  int num, n = addWatchParam(c);
+  nchar += printOneWatch(stdout, n, getWatches(&num) + n - 1);
+}
+
 /* doNext will do a step on next instruction. If it is a jump to 
  * subroutine call, set up temp break point after subroutine call.
  */
 static void doNext()
 {
-  int line, brkAddr = UNDEF, addr = pc, repeat = getNumParam(TRUE);
+  int line, brkAddr = UNDEF, addr = sim->pc, repeat = getNumParam(TRUE);
   if (repeat == UNDEF) repeat = 1;
   
   while (repeat--) 
     { 
-      if (isJSR(memory[pc]))
+      if (isJSR(sim->memory[sim->pc]))
 	{
 	  /* next opcode is a subroutine call
 	   * find address of next line of assembly. 
 	   */
-	  line = asm_Lines[pc] + 1;
+	  line = asm_Lines[sim->pc] + 1;
 	  brkAddr = lines[line - 1].pc;
-	  if (memory[lines[line].pc]>0) setNextBrk(brkAddr);
-	  addr = run(pc, FALSE); 
-	  if (addr != brkAddr) dsp_brk(asm_Lines[addr]);
+	  if (!isBrk(sim, brkAddr)) setNextBrk(brkAddr);
+	  addr = run(sim->pc, FALSE); 
+	  if (addr != brkAddr || sim->watch_hit) dsp_brk(asm_Lines[addr]);
 	}
       else
 	stepOne();
@@ -695,7 +865,7 @@ static void doPrintExpr(int base)
 	  printf(newLine); nchar = strlen(newLine - 1);
 	}
       nchar += printf("%s:", expr);
-      value = getExpr(expr);
+      value = getSimExpr(expr);
       if (!value) { printf(" 0"); return; }
       switch (base)
 	{
@@ -724,7 +894,7 @@ static void doPrintLine()
 {
   char *line;
   int lineNo = getNumParam(FALSE);
-  if (lineNo == UNDEF) lineNo = asm_Lines[pc];
+  if (lineNo == UNDEF) lineNo = asm_Lines[sim->pc];
   do
     {
       if (nchar) { printf(newLine); nchar = 0; }
@@ -778,28 +948,31 @@ static void doPrintMemory(char c)
 {
   int addr, length;
   char *expr, d = (c) ? c : ' ';
-  int *mem, i;
+  int *mem, value, i;
 
   if (c) 
     {
       addr = getNumParam(FALSE);
       if (addr  == UNDEF) longjmp(err, miss_param);
-      mem = getMemory(addr, c);
+      value = getMemory(sim, addr, c);
     }
   else
     {
       expr = getStrParam(TRUE, FALSE);
       mem = getMemExpr(expr, &addr, &c);
+      value = (mem) ? *mem : UNDEF;
     }
+  if (value == UNDEF) longjmp(err, bad_addr);
 
   length = getNumParam(TRUE);
   if (length == UNDEF) length = 1;
   
-  nchar += printf("%04X:%c %02X", addr, d, *mem);
+  nchar += printf("%04X:%c %02X", addr, d, value);
   for (i = 1; i<length; ++i)
     {
+      if ((value = getMemory(sim, addr + i, c)) == UNDEF) break;
       if (!((addr + i)%16)) nchar = printf("%s%04X:%c", newLine, addr+i, d);
-      nchar += printf(" %02X", *getMemory(addr + i, c));
+      nchar += printf(" %02X", value);
     }
 }
 
@@ -812,12 +985,481 @@ static void doResume()
 
   while (repeat--) 
     {
-      addr = run(pc, FALSE);
+      addr = run(sim->pc, FALSE);
       if (addr != UNDEF) dsp_brk(asm_Lines[addr]);
       display();
     }
 }
 
+/* run number of instructions, or cycles if followed by 'c', as fast as
+ * possible. Print host time used and million instructions per second
+ */
+static void doRunFor()
+{
+  struct timeval start, end;
+  unsigned long long instrs, start_cycles = sim->cycles;
+  double sec;
+  int addr, n = getNumParam(FALSE);
+  char *c = getStrParam(FALSE, TRUE);
+
+  if (n == UNDEF) longjmp(err, miss_param);
+  if (n<0) longjmp(err, out_range);
+  if (c && strcmp(c, "c")) longjmp(err, bad_param);
+
+  gettimeofday(&start, NULL);
+  addr = runFor(n, c != NULL, &instrs);
+  gettimeofday(&end, NULL);
+
+  sec = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec)/1e6;
+  nchar += printf("%llu instructions, %llu cycles in %.3f sec (%.2f MIPS)",
+		  instrs, sim->cycles - start_cycles, sec, (sec>0) ? instrs/sec/1e6 : 0.0);
+  if (addr != UNDEF) dsp_brk(asm_Lines[addr]);
+  display();
+}
+
+/* step back instructions in the undo log
+ */
+static void doRevStep()
+{
+  int repeat = getNumParam(TRUE);
+  if (repeat == UNDEF) repeat = 1;
+
+  while (repeat--)
+    {
+      if (stepBack()) continue;
+      nchar += printf("Start of undo log");
+      break;
+    }
+  display();
+}
+
+/* resume execution backwards until a break or the start of the undo log
+ */
+static void doRevCont()
+{
+  int addr = UNDEF, repeat = getNumParam(TRUE);
+  if (repeat == UNDEF) repeat = 1;
+
+  while (repeat--)
+    {
+      addr = runBack();
+      if (addr == UNDEF) break;
+      dsp_brk(asm_Lines[addr]);
+    }
+  if (addr == UNDEF) nchar += printf("Start of undo log");
+  display();
+}
+
+/* set size of the undo log or print it
+ */
+static void doUndo()
+{
+  static int size = 0;
+  int n = getNumParam(TRUE);
+
+  if (n != UNDEF)
+    {
+      if (n<0) longjmp(err, out_range);
+      setUndo(size = n);
+    }
+  if (size)
+    nchar += printf("Undo log of last %d instructions", size);
+  else
+    nchar += printf("Undo log is off");
+}
+
+/* source lines or labels with the instructions and cycles executed by
+ * them while profiling
+ */
+typedef struct
+{
+  char *name;                /* label, NULL for a source line      */
+  int line;                  /* index of its line in lines[]       */
+  unsigned long long count;  /* number of instructions executed    */
+  unsigned long long cycles; /* cycles they took                   */
+} prof_sum;
+
+/* qsort helper, most cycles first and then by line
+ */
+static int cmpProf(const void *e1, const void *e2)
+{
+  const prof_sum *p1 = e1, *p2 = e2;
+
+  if (p1->cycles != p2->cycles) return (p1->cycles<p2->cycles) ? 1 : -1;
+  return p1->line - p2->line;
+}
+
+/* return name of the address label defined by line l or NULL
+ */
+static char *lineLabel(int l, char *name)
+{
+  const char *b = lines[l].line;
+  label_type *label;
+  int i;
+
+  for (i = 0; i<BUFFER_SIZE - 1 && isLabel(tolower(b[i])); ++i) name[i] = tolower(b[i]);
+  name[i] = '\0';
+  if (!i || !isalpha(name[0]) || b[i] != ':') return NULL;
+  label = getLabel(name);
+  return (label && label->value == lines[l].pc) ? name : NULL;
+}
+
+/* sum the profile of each address into *sums by source line and into
+ * *labels by the label that the line follows. Returns the total cycles
+ */
+static unsigned long long sumProfile(prof_sum **sums, int *num_sums, 
+				     prof_sum **labels, int *num_labels)
+{
+  char name[BUFFER_SIZE];
+  unsigned long long count, cycles, total = 0;
+  prof_sum *label = NULL;
+  int addr, l, size_labels = 0;
+
+  *num_sums = 0;
+  while (lines[*num_sums].line) ++*num_sums;
+  safeCalloc(*sums, prof_sum, *num_sums);
+  for (l = 0; l<*num_sums; ++l) (*sums)[l].line = l;
+  for (addr = 0; addr<MEMORY_MAX; ++addr)
+    {
+      if (!(count = getProfile(addr, &cycles))) continue;
+      total += cycles;
+      if (asm_Lines[addr] == UNDEF) continue;
+      (*sums)[asm_Lines[addr] - 1].count += count;
+      (*sums)[asm_Lines[addr] - 1].cycles += cycles;
+    }
+
+  *num_labels = 0;
+  for (l = 0; l<*num_sums; ++l)
+    {
+      if (lineLabel(l, name))
+	{
+	  safeAddArray(prof_sum, *labels, *num_labels, size_labels);
+	  label = *labels + (*num_labels)++;
+	  label->name = NULL;
+	  safeDupStr(label->name, name);
+	  label->line = l;
+	  label->count = label->cycles = 0;
+	}
+      if (!label) continue;
+      label->count += (*sums)[l].count;
+      label->cycles += (*sums)[l].cycles;
+    }
+  return total;
+}
+
+/* print the n source lines and labels that took the most cycles
+ */
+static void writeProfTop(FILE *fd, int n)
+{
+  prof_sum *sums = NULL, *labels = NULL, *p;
+  unsigned long long total;
+  int i, num_sums, num_labels;
+
+  total = sumProfile(&sums, &num_sums, &labels, &num_labels);
+  if (!total)
+    {
+      fprintf(fd, "No instructions profiled\n");
+      free(sums);
+      return;
+    }
+  qsort(sums, num_sums, sizeof(prof_sum), &cmpProf);
+  qsort(labels, num_labels, sizeof(prof_sum), &cmpProf);
+
+  fprintf(fd, "%llu cycles profiled\n\n", total);
+  fprintf(fd, "    cycles      %%      count  line\n");
+  for (p = sums; p<sums + n && p<sums + num_sums && p->cycles; ++p)
+    {
+      fprintf(fd, "%10llu %5.1f%% %10llu %5d %04X: %s\n", p->cycles, 100.0*p->cycles/total,
+	      p->count, p->line + 1, lines[p->line].pc, lines[p->line].line);
+    }
+  fprintf(fd, "\n    cycles      %%      count  label\n");
+  for (p = labels; p<labels + n && p<labels + num_labels && p->cycles; ++p)
+    {
+      fprintf(fd, "%10llu %5.1f%% %10llu %5d %04X: %s\n", p->cycles, 100.0*p->cycles/total,
+	      p->count, p->line + 1, lines[p->line].pc, p->name);
+    }
+  for (i = 0; i<num_labels; ++i) free(labels[i].name);
+  free(labels);
+  free(sums);
+}
+
+/* name of the subroutine at addr is its label or $addr
+ */
+static char *addrLabel(int addr, char *name)
+{
+  int l;
+
+  if (asm_Lines[addr] != UNDEF)
+    {
+      for (l = asm_Lines[addr] - 1; l>=0 && lines[l].pc == addr; --l)
+	{
+	  if (lineLabel(l, name)) return name;
+	}
+    }
+  sprintf(name, "$%04X", addr);
+  return name;
+}
+
+/* cycles of a subroutine in the call graph. total includes the cycles
+ * of the subroutines it called, self does not
+ */
+typedef struct
+{
+  int addr;
+  unsigned long long calls;
+  unsigned long long self;
+  unsigned long long total;
+} call_sum;
+
+/* qsort helpers, by address and by most total cycles first
+ */
+static int cmpCallAddr(const void *e1, const void *e2)
+{
+  const call_sum *c1 = e1, *c2 = e2;
+  return c1->addr - c2->addr;
+}
+
+static int cmpCallTotal(const void *e1, const void *e2)
+{
+  const call_sum *c1 = e1, *c2 = e2;
+
+  if (c1->total != c2->total) return (c1->total<c2->total) ? 1 : -1;
+  return c1->addr - c2->addr;
+}
+
+/* print the n subroutines that took the most cycles with the ones they
+ * called. Recursive calls are counted once in the total of a subroutine
+ */
+static void writeProfCalls(FILE *fd, int n)
+{
+  char name[BUFFER_SIZE];
+  const call_node *nodes;
+  unsigned long long *total = NULL;
+  call_sum *sums = NULL;
+  int i, j, num, num_sums = 0;
+
+  /* a node is always added after the node that called it
+   */
+  nodes = getCalls(&num);
+  if (num) safeCalloc(total, unsigned long long, num);
+  for (i = num - 1; i>=0; --i)
+    {
+      total[i] += nodes[i].cycles;
+      if (i) total[nodes[i].parent] += total[i];
+    }
+  if (!num || !total[0])
+    {
+      fprintf(fd, "No instructions profiled\n");
+      free(total);
+      return;
+    }
+
+  safeCalloc(sums, call_sum, num);
+  for (i = 0; i<num; ++i)
+    {
+      sums[i].addr = nodes[i].addr;
+      sums[i].calls = nodes[i].calls;
+      sums[i].self = nodes[i].cycles;
+      for (j = nodes[i].parent; j != UNDEF && nodes[j].addr != nodes[i].addr; j = nodes[j].parent);
+      if (j == UNDEF) sums[i].total = total[i];
+    }
+  qsort(sums, num, sizeof(call_sum), &cmpCallAddr);
+  for (i = 0; i<num; ++i)
+    {
+      if (num_sums && sums[num_sums - 1].addr == sums[i].addr)
+	{
+	  sums[num_sums - 1].calls += sums[i].calls;
+	  sums[num_sums - 1].self += sums[i].self;
+	  sums[num_sums - 1].total += sums[i].total;
+	}
+      else
+	sums[num_sums++] = sums[i];
+    }
+  qsort(sums, num_sums, sizeof(call_sum), &cmpCallTotal);
+
+  fprintf(fd, "     total      %%       self      %%      calls  subroutine\n");
+  for (i = 0; i<n && i<num_sums; ++i)
+    {
+      fprintf(fd, "%10llu %5.1f%% %10llu %5.1f%% %10llu  %04X %s\n", sums[i].total,
+	      100.0*sums[i].total/total[0], sums[i].self, 100.0*sums[i].self/total[0],
+	      sums[i].calls, sums[i].addr, addrLabel(sums[i].addr, name));
+    }
+  free(sums);
+  free(total);
+}
+
+/* write the call graph as folded stacks: the subroutines of each path
+ * of calls seperated by ';' and the cycles taken at its end. These are
+ * read by flame graph tools
+ */
+static void writeProfFold(FILE *fd)
+{
+  char name[BUFFER_SIZE];
+  const call_node *nodes;
+  int i, j, d, num, *path = NULL;
+
+  nodes = getCalls(&num);
+  if (!num) return;
+  safeCalloc(path, int, num);
+  for (i = 0; i<num; ++i)
+    {
+      if (!nodes[i].cycles) continue;
+      for (d = 0, j = i; j != UNDEF; j = nodes[j].parent) path[d++] = j;
+      while (d--) fprintf(fd, "%s%c", addrLabel(nodes[path[d]].addr, name), (d) ? ';' : ' ');
+      fprintf(fd, "%llu\n", nodes[i].cycles);
+    }
+  free(path);
+}
+
+/* write listing with the instructions executed and cycles of each line
+ */
+static void writeProfList(FILE *fd)
+{
+  prof_sum *sums = NULL, *labels = NULL;
+  int l, num_sums, num_labels;
+
+  sumProfile(&sums, &num_sums, &labels, &num_labels);
+  for (l = 0; l<num_sums; ++l)
+    {
+      if (sums[l].count)
+	fprintf(fd, "%10llu %10llu ", sums[l].count, sums[l].cycles);
+      else
+	fprintf(fd, "%22s", "");
+      fprintf(fd, "%5d %04X: %s\n", l + 1, lines[l].pc, lines[l].line);
+    }
+  for (l = 0; l<num_labels; ++l) free(labels[l].name);
+  free(labels);
+  free(sums);
+}
+
+/* start or stop profiling, print the hot spots, the profiled listing or
+ * the call graph
+ */
+static void doProfile()
+{
+  char *file, *p = getStrParam(FALSE, FALSE);
+  FILE *fd;
+  int n;
+
+  if (nchar) { printf("\n"); nchar = 0; }
+  if (p && (!strcmp(p, "on") || !strcmp(p, "off")))
+    {
+      if (getStrParam(FALSE, FALSE)) longjmp(err, extra_param);
+      setProfile(!strcmp(p, "on"));
+      nchar += printf("Profiling is %s", p);
+    }
+  else if (p && (!strcmp(p, "list") || !strcmp(p, "fold")))
+    {
+      file = getStrParam(FALSE, TRUE);
+      if (!(fd = (file) ? fopen(file, "w") : stdout)) longjmp(err, bad_param);
+      if (p[0] == 'l') writeProfList(fd); else writeProfFold(fd);
+      if (file) fclose(fd);
+    }
+  else if (p && !strcmp(p, "calls"))
+    {
+      n = getNumParam(TRUE);
+      if (n == UNDEF) n = 10;
+      if (n<0) longjmp(err, out_range);
+      writeProfCalls(stdout, n);
+    }
+  else
+    {
+      n = (p) ? getExpr(p) : 10;
+      if (p && getStrParam(FALSE, FALSE)) longjmp(err, extra_param);
+      if (n<0) longjmp(err, out_range);
+      writeProfTop(stdout, n);
+    }
+}
+
+/* return TRUE if line l has the instruction at its address
+ */
+static int isInstrLine(int l)
+{
+  return instr_start[lines[l].pc] && asm_Lines[lines[l].pc] == l + 1;
+}
+
+/* print how much of the instructions and branch directions of the
+ * assembled code map has recorded
+ */
+static void writeCoverSum(FILE *fd, const cover_map *map)
+{
+  int addr, op, instrs = 0, exec = 0, dirs = 0, taken = 0;
+
+  for (addr = 0; addr<MEMORY_MAX; ++addr)
+    {
+      if (!instr_start[addr]) continue;
+      ++instrs;
+      if (isCovered(map->exec, addr)) ++exec;
+      op = memory[addr];
+      if (!isCondBranch(op)) continue;
+      dirs += 2;
+      if (isCovered(map->taken, addr)) ++taken;
+      if (isCovered(map->next, addr)) ++taken;
+    }
+  fprintf(fd, "%d of %d instructions (%.1f%%), %d of %d branch directions (%.1f%%) executed\n",
+	  exec, instrs, (instrs) ? 100.0*exec/instrs : 0.0, taken, dirs, (dirs) ? 100.0*taken/dirs : 0.0);
+}
+
+/* write listing with the code recorded in map. An instruction line is
+ * marked with x if executed or - if not, and a conditional branch with
+ * t if it went to its target and n if it fell through
+ */
+static void writeCoverList(FILE *fd, const cover_map *map)
+{
+  int l, addr;
+
+  writeCoverSum(fd, map);
+  for (l = 0; lines[l].line; ++l)
+    {
+      addr = lines[l].pc;
+      if (!isInstrLine(l))
+	fprintf(fd, "    ");
+      else if (!isCondBranch(memory[addr]))
+	fprintf(fd, "%c   ", isCovered(map->exec, addr) ? 'x' : '-');
+      else
+	fprintf(fd, "%c %c%c", isCovered(map->exec, addr) ? 'x' : '-',
+		isCovered(map->taken, addr) ? 't' : '-', isCovered(map->next, addr) ? 'n' : '-');
+      fprintf(fd, " %5d %04X: %s\n", l + 1, addr, lines[l].line);
+    }
+}
+
+/* start or stop recording the code executed, print how much of it was
+ * or the listing of it or save its map
+ */
+static void doCover()
+{
+  static cover_map *map = NULL;
+  char *file, *p = getStrParam(FALSE, FALSE);
+  FILE *fd;
+
+  if (p && (!strcmp(p, "on") || !strcmp(p, "off")))
+    {
+      if (getStrParam(FALSE, FALSE)) longjmp(err, extra_param);
+      if (p[1] == 'n') safeCalloc(map, cover_map, 1);
+      setCover(sim, (p[1] == 'n') ? map : NULL);
+      nchar += printf("Coverage is %s", p);
+      return;
+    }
+  if (!map) longjmp(err, bad_param);
+  if (nchar) { printf("\n"); nchar = 0; }
+  if (p && !strcmp(p, "list"))
+    {
+      file = getStrParam(FALSE, TRUE);
+      if (!(fd = (file) ? fopen(file, "w") : stdout)) longjmp(err, bad_param);
+      writeCoverList(fd, map);
+      if (file) fclose(fd);
+    }
+  else if (p && !strcmp(p, "save"))
+    {
+      file = getStrParam(TRUE, TRUE);
+      if (!saveCover(map, file)) longjmp(err, bad_param);
+    }
+  else if (p)
+    longjmp(err, bad_param);
+  else
+    writeCoverSum(stdout, map);
+}
+
 /* execute (s)tep command
  */
 static void doStep()
@@ -825,7 +1467,13 @@ static void doStep()
   int repeat = getNumParam(TRUE);
   if (repeat == UNDEF) repeat = 1;
 
-  while (repeat--) stepOne();
+  while (repeat--) 
+    {
+      stepOne();
+      if (!sim->watch_hit) continue;
+      dsp_brk(asm_Lines[sim->pc]);
+      break;
+    }
   display();
 }
 
@@ -844,8 +1492,8 @@ static void doTrace()
   int repeat = getNumParam(TRUE);
   if (repeat == UNDEF) repeat = 1;
   
-  while (repeat--) run(pc, TRUE);
-  if (pc != UNDEF) dsp_brk(asm_Lines[pc]);
+  while (repeat--) run(sim->pc, TRUE);
+  if (sim->pc != UNDEF) dsp_brk(asm_Lines[sim->pc]);
 }
 
 /* print registers. '-' parameter means print all tokens that are registers
@@ -864,7 +1512,7 @@ static void doPrintReg()
 	{
 	  for (t=0; t<tokens_length; ++t)
 	    {
-	      if (!(reg = getRegister(tokens[t], &bit, &bytes))) continue;
+	      if (!(reg = getRegister(sim, tokens[t], &bit, &bytes))) continue;
 	      if (nchar>LNLNGTH) { printf(newLine); nchar = 0; }
 	      fmt[6] = (bit == UNDEF) ? '0' + 2*bytes : '1';
 	      nchar += printf(fmt, tokens[t], (bit == UNDEF) ? *reg : (*reg&bit)>0);
@@ -873,7 +1521,12 @@ static void doPrintReg()
       else
 	{
 	  if (nchar>LNLNGTH) { printf(newLine); nchar = 0; }
-	  if (!(reg = getRegister(p, &bit, &bytes))) longjmp(err, no_reg);
+	  if (!strcmp(p, "cycles"))
+	    {
+	      nchar += printf("%s: %llu ", p, sim->cycles);
+	      continue;
+	    }
+	  if (!(reg = getRegister(sim, p, &bit, &bytes))) longjmp(err, no_reg);
 	  fmt[6] = (bit == UNDEF) ? '0' + 2*bytes : '1';
 	  nchar += printf(fmt, p, (bit == UNDEF) ? *reg : (*reg&bit)>0);
 	}
@@ -899,10 +1552,13 @@ static void doCmd(str_storage b)
     case brk_tmp:  doBrk(TRUE);        break;
     case clr_brk:  doClrBrk();         break;
     case clr_dsp:  doClrDsp();         break;
+    case clr_watch: doClrWatch();      break;
+    case coverage: doCover();          break;
     case go:       doGo();             break;
     case intr:     doIRQ();            break;
     case list_brk: doListBrk();        break;
     case list_dsp: doListDsp();        break;
+    case list_watch: doListWatch();    break;
     case next:     doNext();           break;
     case pr_dec:
     case print:    doPrintExpr(10);    break;
@@ -911,10 +1567,15 @@ static void doCmd(str_storage b)
     case pr_line:  doPrintLine();      break;
     case pr_led:   doPrintLED();       break;
     case pr_reg:   doPrintReg();       break;
+    case profile:  doProfile();        break;
     case quit:     
       done = answer("Quit simulator"); break;
-    case resetSim: reset();            break;
+    case resetSim: reset(sim); clearUndo(); break;
     case resume:   doResume();         break;
+    case rev_cont: doRevCont();        break;
+    case rev_step: doRevStep();        break;
+    case undo:     doUndo();           break;
+    case run_for:  doRunFor();         break;
     case stpln:    doStep();           break;
     case trace:    doTrace();          break;
     default:
@@ -934,6 +1595,9 @@ static void doCmd(str_storage b)
 	case 'm':
 	  doMem(t[1]);
 	  break;
+	case 'w':
+	  doWatch(t[1]);
+	  break;
 	case 'p': 
 	  if (t[1] == 'm') 
 	    {
@@ -994,14 +1658,21 @@ static FILE *safeOpen(char* filename, char* mode)
  */
 static void printSimHelp(void)
 {
-  printf("sim [-qc] file.asm\n"
+  printf("sim [-qc] [-t tx] [-r rx] file.asm\n"
 	 "Load the file.asm assembly file and begin simulating it.\n"
 	 "Type 'h' for help inside the simulator\n\n"
 	 "    -h    print this message and exit\n"
 	 "    -V    print simulator version and exit\n"
 	 "    -q    don't print out version info on startup\n"
 	 "    -c    load memory dump in file.core\n"
+	 "    -t    write the bytes sent by the serial port to file tx\n"
+	 "    -r    receive the bytes of file rx by the serial port. A number\n"
+	 "          for tx or rx is an open file descriptor, e.g. a socket\n"
 	 " --asm    Run this program as an assembler. Run 'sim --asm -h' for details\n"
+	 " --batch  Run many simulations from a manifest. Run 'sim --batch -h' for details\n"
+	 " --run    Run without a prompt and print the final state. Run 'sim --run -h' for details\n"
+	 " --core   Convert a core file between snapshot and text dump. Run 'sim --core -h' for details\n"
+	 " --cover  Print the code executed by runs. Run 'sim --cover -h' for details\n"
 	 "\nProject homepage: http://microsim.sourceforge.net\n"
 	 "Send bug reports to jim@termanweb.net\n");
   exit(1);
@@ -1110,12 +1781,12 @@ static char *newSuffix(char *oldname, char *newsuffix)
 }
 
 /* my signal handler. If cntrl-c trapped and simultion running
- * dump out memory to core file. Otherwise, exit the program gracefully.
+ * write a snapshot to core file. Otherwise, exit the program gracefully.
  */
 void myhandler(int signum)
 {
   char *core;
-  FILE *fd;
+  int fd;
 
   if (signum != SIGINT && signum != SIGABRT) 
     {
@@ -1128,34 +1799,150 @@ void myhandler(int signum)
   else
     {
       core = newSuffix(filename, "core");
-      fd = safeOpen(core, "w");
-      dumpMemory(fd);
-      fprintf(stderr, "Simulator was interrupted. Memory dumped to %s\n", core);
+      if ((fd = open(core, O_WRONLY | O_CREAT | O_TRUNC, 0666))<0 || !saveSnap(sim, fd, TRUE))
+	fprintf(stderr, "Simulator was interrupted. Can't write %s\n", core);
+      else
+	fprintf(stderr, "Simulator was interrupted. Memory dumped to %s\n", core);
     }
   exit(1);
 }
 
-/* main loop for simulator. Process command lines, load assembly
- * file, assemble it and enter command line loop
+/* load machine s from core file, a snapshot or a text dump. Exits if
+ * the file can not be read
  */
-int main_sim(int argc, char *argv[])
+static void loadCore(sim_ctx *s, char *core)
 {
-  int c, errNo, i, l, numErr = 0, silent = FALSE, core = FALSE;
-  char *line, *coreFile = 0, *temp = getTmpFile("sim");
-  unsigned int m;
-  FILE *fd;
-
-  if (argc<2) printSimHelp();
+  FILE *fd = safeOpen(core, "r");
+
+  if (isSnap(fileno(fd)))
+    {
+      if (!loadSnap(s, fileno(fd)))
+	{
+	  fprintf(stderr, "%s is not a snapshot of this processor\n", core);
+	  exit(1);
+	}
+    }
+  else
+    restoreMemory(s, fd);
+  fclose(fd);
+}
+
+/* open file of the serial port with flags. A number is a file
+ * descriptor that is already open, e.g. a socket or a pipe of the shell
+ */
+static int openSerial(char *file, int flags)
+{
+  char *e;
+  int fd = strtol(file, &e, 10);
+
+  if (*file && !*e) return fd;
+  if ((fd = open(file, flags, 0666))<0)
+    {
+      fprintf(stderr, "Cannot open %s\n", file);
+      exit(1);
+    }
+  return fd;
+}
+
+/* connect the serial port of sim to file tx, for the bytes sent, and
+ * rx, for the bytes received, if either is given. Exits on an error
+ */
+static void connectSerial(char *tx, char *rx)
+{
+  int out = UNDEF, in = UNDEF;
+
+  if (!tx && !rx) return;
+  if (tx) out = openSerial(tx, O_WRONLY | O_CREAT | O_TRUNC);
+  if (rx) in = openSerial(rx, O_RDONLY);
+  if (!setSerial(sim, out, in))
+    {
+      fprintf(stderr, "This processor has no serial port\n");
+      exit(1);
+    }
+}
+
+/* write a snapshot of machine s with code memory to file core. Exits
+ * if it can not be written
+ */
+static void saveCore(sim_ctx *s, char *core, int code)
+{
+  int fd = open(core, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+  if (fd<0 || !saveSnap(s, fd, code) || close(fd))
+    {
+      fprintf(stderr, "Can't write file %s\n", core);
+      exit(1);
+    }
+}
+
+/* assemble file for the simulator, mapping each address to its line
+ * with a listing in tmp file temp. Then create the machine sim and
+ * reset it or load it from file.core. Returns TRUE on assembly errors
+ */
+static int startSim(char *file, char *temp, int core)
+{
+  int i, l, numErr = 0;
+  unsigned int m;
+
+  filename = file;
+  loadFile(filename);
+
+  obj = NULL;
+  numErr += doPass(&firstPass);
+  lst = openTmpFile(temp, "w+");
+  numErr += doPass(&secondPass);
+  if (numErr) 
+    {
+      printf("Assembly terminated with %d errors.\n", numErr);
+      return (numErr>0);
+    }
+
+  rewind(lst);
+  for (i = 0; i<MEMORY_MAX; ++i) asm_Lines[i] = UNDEF;
+  do 
+    {
+      i = fscanf(lst, "%5d %04X%*[^\n]\n", &l, &m);
+      if (i!=2) continue;
+      asm_Lines[m] = l;
+      lines[l-1].pc = m;
+    } 
+  while (!feof(lst));
+  safeCloseTmp(lst, TRUE);
+
+  sim = newSim(memory); /* runs on the assembled code */
+  run_sim = TRUE;
+  if (core)
+    loadCore(sim, newSuffix(filename, "core"));
+  else
+    reset(sim);
+  return FALSE;
+}
+
+/* main loop for simulator. Process command lines, load assembly
+ * file, assemble it and enter command line loop
+ */
+int main_sim(int argc, char *argv[])
+{
+  int c, errNo, i, numErr, silent = FALSE, core = FALSE;
+  char *line, *tx = NULL, *rx = NULL, *temp = getTmpFile("sim");
+
+  if (argc<2) printSimHelp();
 
   for (i = 1; i < argc; ++i) {
     if (!strcmp(argv[i], "-fullname")) argv[i] = "-f";
     if (!strcmp(argv[i], "-cd")) argv[i] = "-d";
   }
 
-  while ((c = getopt(argc, argv, "cqfVhd:")) != EOF)
+  while ((c = getopt(argc, argv, "cqfVhd:r:t:")) != EOF)
     {
       switch (c)
 	{
+	case 't':
+	  tx = optarg;
+	  break;
+	case 'r':
+	  rx = optarg;
+	  break;
 	case 'V':
 	  printf(sim_version); printf(cpu_version);
 	  exit(0);
@@ -1181,51 +1968,18 @@ int main_sim(int argc, char *argv[])
 	}
     }
   if (optind + 1 > argc) printSimHelp();
-  filename = argv[optind];
-  loadFile(filename);
-
-  obj = NULL;
-  numErr += doPass(&firstPass);
-  lst = openTmpFile(temp, "w+");
-  numErr += doPass(&secondPass);
-  if (numErr) 
-    {
-      printf("Assembly terminated with %d errors.\n", numErr);
-      return (numErr>0);
-    }
-
-  rewind(lst);
-  for (i = 0; i<MEMORY_MAX; ++i) asm_Lines[i] = UNDEF;
-  do 
-    {
-      i = fscanf(lst, "%5d %04X%*[^\n]\n", &l, &m);
-      if (i!=2) continue;
-      asm_Lines[m] = l;
-      lines[l-1].pc = m;
-    } 
-  while (!feof(lst));
-  safeCloseTmp(lst, TRUE);
-
-  run_sim = TRUE;
-  if (core)
-    {
-      coreFile = newSuffix(filename, "core");
-      fd = safeOpen(coreFile, "r");
-      restoreMemory(fd);
-      fclose(fd);
-    }
-  else
-    reset();
+  if ((numErr = startSim(argv[optind], temp, core))) return numErr;
+  connectSerial(tx, rx);
   if (!silent) 
     {
       printf(sim_version); 
       printf(cpu_version);
       printf("\n");
     }
-  printf("Simulating file %s starting at line %d\n", filename, asm_Lines[pc]);
+  printf("Simulating file %s starting at line %d\n", filename, asm_Lines[sim->pc]);
   while (!done)
     {
-      if (emacs) printf("\032\032%s:%d:0\n", filename, asm_Lines[pc]);
+      if (emacs) printf("\032\032%s:%d:0\n", filename, asm_Lines[sim->pc]);
       strcpy(newLine, "\n");
       if (nchar) { printf("\n"); nchar = 0; }
       printf("> "); fflush(stdout);
@@ -1241,12 +1995,505 @@ int main_sim(int argc, char *argv[])
 	printErrNo(errNo);
       else
 	doCmd(cmd_store);
+      flushSerial(sim);
     }
 
+  freeSim(sim);
   remove(temp);
   return 0;
 }
 
+/* exit codes of sim --run. A cpu error exits with RUN_ERR plus its
+ * number counted from pc_overflow
+ */
+#define RUN_STOP 0  /* break or halt found           */
+#define RUN_COUNT 2 /* all instructions executed     */
+#define RUN_ERR 3   /* first exit code of cpu errors */
+
+/* print command line help for headless runs
+ */
+static void printRunHelp(void)
+{
+  printf("sim --run [-c] [-s core] [-p prof] [-g fold] [-C map] [-n count] [-b addr]... [-w addr]...\n"
+	 "          [-i irq]... [-m addr]... [-t tx] [-r rx] file.asm\n"
+	 "Assemble file.asm and run it without a prompt until a break, a halt\n"
+	 "(an instruction jumping to itself), a watch, count instructions or an error.\n"
+	 "A halt waits as long as an interrupt can still be taken.\n"
+	 "Then print how it stopped, the registers, cycles and memory.\n\n");
+  printf("    -h    print this message and exit\n"
+	 "    -V    print simulator version and exit\n"
+	 "    -c    load memory dump in file.core instead of reset\n"
+	 "    -s    write a snapshot to file core at the end of the run\n"
+	 "    -p    profile the run and write the hot spots, the subroutines and\n"
+	 "          the listing with the cycles of each line to file prof\n"
+	 "    -g    profile the run and write its calls as folded stacks to file\n"
+	 "          fold, see 'prof fold' in the simulator\n"
+	 "    -C    write the map of the code executed to file map, see sim --cover\n"
+	 "    -n    execute at most count instructions\n"
+	 "    -b    break at address addr [if expr], may be repeated\n"
+	 "    -w    watch memory as the 'w' command with parameters addr,\n"
+	 "          may be repeated\n"
+	 "    -i    request an interrupt as the 'i' command with parameters irq,\n"
+	 "          e.g. \"0 1000\" after 1000 cycles, may be repeated\n"
+	 "    -t    write the bytes sent by the serial port to file tx\n"
+	 "    -r    receive the bytes of file rx by the serial port, see sim -h\n"
+	 "    -m    print memory as the 'pm' command with parameters addr,\n"
+	 "          may be repeated\n\n"
+	 "Exit code is %d at a break, halt or watch, %d when count is reached and 1 for other\n"
+	 "errors. Simulator errors exit with %d for program counter overflow, %d stack\n"
+	 "overflow, %d stack underflow, %d divide by zero and %d non-existant opcode.\n"
+	 "\nProject homepage: http://microsim.sourceforge.net\n"
+	 "Send bug reports to jim@termanweb.net\n", RUN_STOP, RUN_COUNT, 
+	 RUN_ERR, RUN_ERR + 1, RUN_ERR + 2, RUN_ERR + 3, RUN_ERR + 4);
+  exit(1);
+}
+
+/* write the hot spots, subroutines and the profiled listing to file
+ * prof and the folded stacks to file fold, if they are not NULL
+ */
+static void saveProfile(char *prof, char *fold)
+{
+  FILE *fd;
+
+  if ((fd = safeOpen(prof, "w")))
+    {
+      writeProfTop(fd, 10);
+      fprintf(fd, "\n");
+      writeProfCalls(fd, 10);
+      fprintf(fd, "\n");
+      writeProfList(fd);
+      fclose(fd);
+    }
+  if ((fd = safeOpen(fold, "w")))
+    {
+      writeProfFold(fd);
+      fclose(fd);
+    }
+}
+
+/* print the registers and cycles followed by the memory given by the
+ * -m parameters of sim --run
+ */
+static void printRun(char **mems, int num_mem)
+{
+  char *cmd = NULL;
+  int i;
+
+  strcpy(newLine, "\n");
+  doCmd("pr - cycles");
+  for (i = 0; i<num_mem; ++i)
+    {
+      printf("\n"); nchar = 0;
+      safeMalloc(cmd, char, strlen(mems[i]) + 4);
+      sprintf(cmd, "pm %s", mems[i]);
+      doCmd(cmd);
+    }
+  free(cmd);
+  printf("\n");
+}
+
+/* run count instructions like runFor(), but a halt only stops the run
+ * when no interrupt can be taken any more to leave it. Until then it
+ * waits for the next event with waitHalt()
+ */
+static int runHalted(unsigned long long count, unsigned long long *instrs)
+{
+  unsigned long long n;
+  int brk;
+
+  *instrs = 0;
+  while ((brk = runFor(count - *instrs, FALSE, &n)) != UNDEF && !sim->watch_hit && 
+	 isHalt(sim, brk) && canInterrupt(sim))
+    {
+      *instrs += n;
+      if (*instrs<count) *instrs += waitHalt(count - *instrs);
+      if (sim->watch_hit) return sim->pc;
+    }
+  *instrs += n;
+  return brk;
+}
+
+/* assemble file and run it to the end without commands from stdin
+ */
+int main_run(int argc, char *argv[])
+{
+  int c, i, brk, errNo, ret, num_brk = 0, num_mem = 0, num_watch = 0, num_irq = 0, core = FALSE;
+  unsigned long long count = ULLONG_MAX, instrs;
+  char *e, *snap = NULL, *prof = NULL, *fold = NULL, *cover = NULL;
+  char **brks = NULL, **mems = NULL, **watches = NULL, **irqs = NULL, *cmd = NULL;
+  char *tx = NULL, *rx = NULL, *temp = getTmpFile("sim");
+  cover_map *map = NULL;
+
+  if (argc<2) printRunHelp();
+  safeCalloc(brks, char*, argc);
+  safeCalloc(mems, char*, argc);
+  safeCalloc(watches, char*, argc);
+  safeCalloc(irqs, char*, argc);
+  while ((c = getopt(argc, argv, "chVb:g:i:m:n:p:r:s:t:w:C:")) != EOF)
+    {
+      switch (c)
+	{
+	case 'V':
+	  printf(sim_version); printf(cpu_version);
+	  exit(0);
+	  break;
+	case 'c':
+	  core = TRUE;
+	  break;
+	case 'b':
+	  brks[num_brk++] = optarg;
+	  break;
+	case 'm':
+	  mems[num_mem++] = optarg;
+	  break;
+	case 'w':
+	  watches[num_watch++] = optarg;
+	  break;
+	case 'i':
+	  irqs[num_irq++] = optarg;
+	  break;
+	case 't':
+	  tx = optarg;
+	  break;
+	case 'r':
+	  rx = optarg;
+	  break;
+	case 'n':
+	  count = strtoull(optarg, NULL, 0);
+	  break;
+	case 's':
+	  snap = optarg;
+	  break;
+	case 'p':
+	  prof = optarg;
+	  break;
+	case 'g':
+	  fold = optarg;
+	  break;
+	case 'C':
+	  cover = optarg;
+	  break;
+	case 'h':
+	default:
+	  printRunHelp();
+	  break;
+	}
+    }
+  if (optind + 1 != argc) printRunHelp();
+  if (startSim(argv[optind], temp, core)) return 1;
+  connectSerial(tx, rx);
+
+  if ((errNo = setjmp(err)) != 0)
+    {
+      printErrNo(errNo);
+      return 1;
+    }
+  for (i = 0; i<num_brk; ++i)
+    {
+      for (e = brks[i]; *e; ++e) *e = tolower(*e);
+      if ((e = strstr(brks[i], " if ")))
+	{
+	  *e = '\0';
+	  e = strdup(e + 4);
+	}
+      addBrk(FALSE, getExpr(brks[i]), e);
+    }
+  for (i = 0; i<MEMORY_MAX; ++i) if (isHalt(sim, i)) addBrk(FALSE, i, NULL);
+  for (i = 0; i<num_mem; ++i) for (e = mems[i]; *e; ++e) *e = tolower(*e);
+  for (i = 0; i<num_watch; ++i)
+    {
+      for (e = watches[i]; *e; ++e) *e = tolower(*e);
+      safeMalloc(cmd, char, strlen(watches[i]) + 3);
+      sprintf(cmd, "w %s", watches[i]);
+      strtok(cmd, "\040\t"); /* parameters follow the command */
+      addWatchParam('\0');
+    }
+  free(cmd);
+  for (i = 0, cmd = NULL; i<num_irq; ++i)
+    {
+      safeMalloc(cmd, char, strlen(irqs[i]) + 3);
+      sprintf(cmd, "i %s", irqs[i]);
+      strtok(cmd, "\040\t");
+      doIRQ();
+    }
+  free(cmd);
+  if (prof || fold) setProfile(TRUE);
+  if (cover)
+    {
+      safeCalloc(map, cover_map, 1);
+      setCover(sim, map);
+    }
+
+  if ((errNo = setjmp(err)) != 0)
+    {
+      printErrNo(errNo);
+      ret = (errNo>=pc_overflow) ? RUN_ERR + errNo - pc_overflow : 1;
+    }
+  else if ((brk = runHalted(count, &instrs)) == UNDEF)
+    {
+      printf("%llu instructions executed\n", instrs);
+      ret = RUN_COUNT;
+    }
+  else if (sim->watch_hit)
+    {
+      printWatchHit(stdout);
+      printf(" at address $%04X, line %d\n", brk, asm_Lines[brk]);
+      ret = RUN_STOP;
+    }
+  else
+    {
+      printf("%s at address $%04X, line %d\n", 
+	     isHalt(sim, brk) ? "halt" : "break", brk, asm_Lines[brk]);
+      ret = RUN_STOP;
+    }
+  flushSerial(sim);
+
+  if ((errNo = setjmp(err)) != 0)
+    {
+      printErrNo(errNo);
+      return 1;
+    }
+  printRun(mems, num_mem);
+  if (snap) saveCore(sim, snap, TRUE);
+  saveProfile(prof, fold);
+  if (cover && !saveCover(map, cover))
+    {
+      fprintf(stderr, "Can't write %s\n", cover);
+      return 1;
+    }
+  return ret;
+}
+
+/* print command line help for core file conversion
+ */
+static void printCoreHelp(void)
+{
+  printf("sim --core in out\n"
+	 "Convert core file in to out. A snapshot is written as a text dump and\n"
+	 "a text dump as a snapshot. The text dump of an 8051 has no code memory\n"
+	 "or cycles, a snapshot converted from it leaves code memory as it is.\n"
+	 "\nProject homepage: http://microsim.sourceforge.net\n"
+	 "Send bug reports to jim@termanweb.net\n");
+  exit(1);
+}
+
+/* convert a core file between the snapshot and the text format
+ */
+int main_core(int argc, char *argv[])
+{
+  sim_ctx *s;
+  FILE *fd;
+  int snap;
+
+  if (argc != 3 || argv[1][0] == '-') printCoreHelp();
+  s = newSim(NULL);
+  reset(s);
+  fd = safeOpen(argv[1], "r");
+  snap = isSnap(fileno(fd));
+  fclose(fd);
+  loadCore(s, argv[1]);
+  if (snap)
+    {
+      fd = safeOpen(argv[2], "w");
+      dumpMemory(s, fd);
+      fclose(fd);
+    }
+  else
+    saveCore(s, argv[2], FALSE);
+  freeSim(s);
+  return 0;
+}
+
+/* print command line help for coverage reports
+ */
+static void printCoverHelp(void)
+{
+  printf("sim --cover [-o out] file.asm map...\n"
+	 "Merge the maps of the code executed by runs of file.asm, written by\n"
+	 "sim --run -C, sim --batch -C or the 'cov save' command. Print how many\n"
+	 "instructions and branch directions were executed and the listing of\n"
+	 "file.asm with x in front of each instruction executed and - if not. A\n"
+	 "conditional branch has t if it went to its target and n if it fell through.\n\n");
+  printf("    -h    print this message and exit\n"
+	 "    -o    write the merged map to file out\n"
+	 "\nProject homepage: http://microsim.sourceforge.net\n"
+	 "Send bug reports to jim@termanweb.net\n");
+  exit(1);
+}
+
+/* merge maps of the code executed and print the listing of it
+ */
+int main_cover(int argc, char *argv[])
+{
+  int c, i;
+  char *out = NULL, *temp = getTmpFile("sim");
+  cover_map *map = NULL;
+
+  if (argc<2) printCoverHelp();
+  while ((c = getopt(argc, argv, "ho:")) != EOF)
+    {
+      switch (c)
+	{
+	case 'o':
+	  out = optarg;
+	  break;
+	case 'h':
+	default:
+	  printCoverHelp();
+	  break;
+	}
+    }
+  if (optind + 2>argc) printCoverHelp();
+  if (startSim(argv[optind], temp, FALSE)) return 1;
+
+  safeCalloc(map, cover_map, 1);
+  for (i = optind + 1; i<argc; ++i)
+    {
+      if (loadCover(map, argv[i])) continue;
+      fprintf(stderr, "%s is not a map of %s code\n", argv[i], cpu_version);
+      return 1;
+    }
+  if (out && !saveCover(map, out))
+    {
+      fprintf(stderr, "Can't write %s\n", out);
+      return 1;
+    }
+  writeCoverList(stdout, map);
+  free(map);
+  freeSim(sim);
+  return 0;
+}
+
+#define BATCH_COUNT 1000000 /* default max instructions of a batch run */
+
+/* print command line help for batch runs
+ */
+static void printBatchHelp(void)
+{
+  printf("sim --batch [-c] [-j threads] [-n count] [-o file] [-C map] file.asm manifest\n"
+	 "Assemble file.asm and run it once for every line of the manifest.\n"
+	 "A line is the name of the run followed by its settings:\n\n"
+	 "    @reg=value          set register\n"
+	 "    $addr[:c]=v1,v2...  set memory, c is the memory type as for 'pm'\n"
+	 "    stop=addr           stop when pc reaches addr\n"
+	 "    count=n             execute at most n instructions\n"
+	 "    cycles=n            execute at most n cycles\n\n"
+	 "Each run starts after a power on reset or, with -c, forked from the machine\n"
+	 "in file.core, sharing its memory pages until it writes them. A line of the\n"
+	 "result has its name, stop, count, cycles or the error it ended with, the\n"
+	 "registers and a checksum of memory. Lines starting with ';' are ignored.\n\n");
+  printf("    -h    print this message and exit\n"
+	 "    -V    print simulator version and exit\n"
+	 "    -c    start every run from the memory dump in file.core\n"
+	 "    -j    number of threads, default is one for each processor\n"
+	 "    -n    default count of instructions (%d)\n"
+	 "    -o    write results to file instead of stdout\n"
+	 "    -C    write the map of the code executed by all runs to file map\n"
+	 "\nProject homepage: http://microsim.sourceforge.net\n"
+	 "Send bug reports to jim@termanweb.net\n", BATCH_COUNT);
+  exit(1);
+}
+
+/* assemble file and execute the runs of the manifest on all processors
+ */
+int main_batch(int argc, char *argv[])
+{
+  int c, i, l, errNo, numErr = 0, threads = 0, count = BATCH_COUNT, core = FALSE;
+  char *line, *manifest, *result = NULL, *cover = NULL;
+  sim_state *state = NULL;
+  cover_map *map = NULL;
+  sim_ctx *s;
+  FILE *fd;
+
+  if (argc<2) printBatchHelp();
+  while ((c = getopt(argc, argv, "chVj:n:o:C:")) != EOF)
+    {
+      switch (c)
+	{
+	case 'V':
+	  printf(sim_version); printf(cpu_version);
+	  exit(0);
+	  break;
+	case 'j':
+	  threads = atoi(optarg);
+	  break;
+	case 'n':
+	  count = atoi(optarg);
+	  break;
+	case 'o':
+	  result = optarg;
+	  break;
+	case 'c':
+	  core = TRUE;
+	  break;
+	case 'C':
+	  cover = optarg;
+	  break;
+	case 'h':
+	default:
+	  printBatchHelp();
+	  break;
+	}
+    }
+  if (optind + 2 != argc) printBatchHelp();
+  filename = argv[optind];
+  manifest = argv[optind + 1];
+  loadFile(filename);
+
+  obj = NULL;
+  lst = NULL;
+  numErr += doPass(&firstPass);
+  numErr += doPass(&secondPass);
+  if (numErr)
+    {
+      printf("Assembly terminated with %d errors.\n", numErr);
+      return 1;
+    }
+
+  fd = safeOpen(manifest, "r");
+  for (l = 1; (line = safeGetLine(fd)); ++l)
+    {
+      for (i = 0; line[i] && isspace(line[i]); ++i);
+      if (line[i] && line[i] != ';')
+	{
+	  if ((errNo = setjmp(err)) != 0)
+	    {
+	      printf("%s:%d: ", manifest, l);
+	      printErrNo(errNo);
+	      return 1;
+	    }
+	  addBatchRun(line + i, count);
+	}
+      free(line);
+    }
+  fclose(fd);
+
+  if (core)
+    {
+      s = newSim(memory);
+      loadCore(s, newSuffix(filename, "core"));
+      if (!(state = saveState(s)))
+	{
+	  fprintf(stderr, "Can't save state of machine\n");
+	  return 1;
+	}
+      freeSim(s);
+    }
+  if (threads<1) threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cover) safeCalloc(map, cover_map, 1);
+  runBatch(threads, memory, state, map);
+  if (state) freeState(state);
+  if (cover && !saveCover(map, cover))
+    {
+      fprintf(stderr, "Can't write %s\n", cover);
+      return 1;
+    }
+  fd = (result) ? safeOpen(result, "w") : stdout;
+  printBatch(fd);
+  if (fd != stdout) fclose(fd);
+  return 0;
+}
+
 /* print command line option for assembler
  */
 static void printAsmHelp(void)
@@ -1405,11 +2652,16 @@ int main(int argc, char *argv[])
   /* Look for --asm option to run as assembler. Run sim as default
    */
   if (!strcmp("--asm", argv[1])) return main_asm(argc - 1, argv + 1);
+  if (!strcmp("--batch", argv[1])) return main_batch(argc - 1, argv + 1);
+  if (!strcmp("--run", argv[1])) return main_run(argc - 1, argv + 1);
+  if (!strcmp("--core", argv[1])) return main_core(argc - 1, argv + 1);
+  if (!strcmp("--cover", argv[1])) return main_cover(argc - 1, argv + 1);
 
   /* Find program name in argv[0]. If first 3 chars of name after directory seperator 
-   * is asm, run as assembler. Run sim for any other name
+   * is asm, run as assembler. Run batch for simbatch and sim for any other name
    */
   arg0 = strrchr(argv[0], DIRSEP);
   arg0 = (arg0) ? arg0 + 1 : argv[0];
+  if (!strncmp("simbatch", arg0, 8)) return main_batch(argc, argv);
   return (strncmp("asm", arg0, 3)) ? main_sim(argc, argv) : main_asm(argc, argv);
 }
@@ -0,0 +1,70 @@
+/*************************************************************************************
+
+    Copyright (c) 2003 - 2005 by James L. Terman
+    This file is part of the 6502 Assembler backend
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ *************************************************************************************/
+#ifndef _ALU_HEADER
+#define _ALU_HEADER
+
+/* add, addc and subb of the simulator. mkalu uses these to generate the
+ * tables in alu_table.h, sim.c looks up the result of acc and value in
+ * them and only calls these when either is not a byte.
+ *
+ * A table entry packs the result with the new carry, auxc and ov bits
+ * of PSW. add_table is indexed by acc and value, addc_table and
+ * subb_table also by the carry.
+ */
+#define ALU_SIZE (2*BYTE_MAX*BYTE_MAX)
+
+#define aluIndex(c, a, b) (((c)*BYTE_MAX + (a))*BYTE_MAX + (b))
+#define aluPack(r, ac, v, c) ((r)*BYTE_MAX + (ac)*auxc + (v)*ov + (c)*carry)
+#define aluResult(e) ((e)/BYTE_MAX)
+#define aluFlags(e) ((e) & BYTE_MASK)
+
+/* PSW bits set by alu, same as in sim.c */
+#define carry 128
+#define auxc   64
+#define ov      4
+
+/* add value to acc, plus carry c if carryFlag is set. The result is
+ * taken with the carry out, as the simulator always did
+ */
+static int aluAdd(int acc, int value, int c, int carryFlag)
+{
+  int ac = ((acc & LO_NYBLE) + (value & LO_NYBLE) + c*carryFlag) > LO_NYBLE;
+  int nc = (acc + value + c*carryFlag) > BYTE_MASK;
+  int v = (((acc & (BYTE_MASK - BIT7_MASK)) + (value & (BYTE_MASK - BIT7_MASK)) + 
+	     c*carryFlag) > (BYTE_MASK - BIT7_MASK)) ^ nc;
+
+  return aluPack((acc + value + nc*carryFlag) & BYTE_MASK, ac, v, nc);
+}
+
+/* sub value and borrow c from acc. The result is taken with the borrow
+ * out, as the simulator always did
+ */
+static int aluSubb(int acc, int value, int c)
+{
+  int ac = ((acc & LO_NYBLE) - (value & LO_NYBLE) - c) < 0;
+  int nc = (acc - value - c) < 0;
+  int v = (((acc & (BYTE_MASK - BIT7_MASK)) - (value & (BYTE_MASK - BIT7_MASK)) - 
+	     c) < 0) ^ nc;
+
+  return aluPack((acc - value - nc) & BYTE_MASK, ac, v, nc);
+}
+
+#endif
@@ -583,3 +583,36 @@ int isJSR(int opcode)
   int t = cpu_instr_tkn[opcode][INSTR_TKN_INSTR];
   return (t == acall || t == acdup || t == lcall);
 }
+
+/* isBranch will return TRUE if opcode can change the flow of execution
+ */
+int isBranch(int opcode)
+{
+  switch (cpu_instr_tkn[opcode][INSTR_TKN_INSTR])
+    {
+    case acall: case acdup: case ajmp: case ajdup: case lcall: case ljmp: 
+    case sjmp:  case jmp:   case ret:  case reti:  case cjne:  case djnz: 
+    case jb:    case jbc:   case jc:   case jnb:   case jnc:   case jnz: case jz:
+      return TRUE;
+      break;
+    default:
+      return FALSE;
+      break;
+    }
+}
+
+/* isCondBranch will return TRUE if opcode branches only on a condition
+ */
+int isCondBranch(int opcode)
+{
+  switch (cpu_instr_tkn[opcode][INSTR_TKN_INSTR])
+    {
+    case cjne: case djnz: case jb: case jbc: case jc: case jnb: 
+    case jnc:  case jnz:  case jz:
+      return TRUE;
+      break;
+    default:
+      return FALSE;
+      break;
+    }
+}
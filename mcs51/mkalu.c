@@ -0,0 +1,150 @@
+/*************************************************************************************
+
+    Copyright (c) 2003 - 2005 by James L. Terman
+    This file is part of the 6502 Assembler backend
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ *************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+
+/* mkalu writes the add, addc and subb tables of the simulator to stdout.
+ * Built with ALU_CHECK, it checks the tables in the generated alu_table.h
+ * and the functions in alu.h against the arithmetic sim.c had before them
+ */
+
+#include "asmdefs.h"
+#include "alu.h"
+
+#ifdef ALU_CHECK
+#include "alu_table.h"
+#endif
+
+/* entries of the tables, i is aluIndex(c, a, b)
+ */
+static int addEntry(int i)  { return aluAdd(i/BYTE_MAX % BYTE_MAX, i % BYTE_MAX, 0, FALSE); }
+static int addcEntry(int i) { return aluAdd(i/BYTE_MAX % BYTE_MAX, i % BYTE_MAX, i/BYTE_MAX/BYTE_MAX, TRUE); }
+static int subbEntry(int i) { return aluSubb(i/BYTE_MAX % BYTE_MAX, i % BYTE_MAX, i/BYTE_MAX/BYTE_MAX); }
+
+#ifndef ALU_CHECK
+/* write table name of n entries returned by f, size is n in C
+ */
+static void writeTable(const char *name, const char *size, int n, int (*f)(int))
+{
+  int i;
+
+  printf("const unsigned short %s[%s] =\n  {", name, size);
+  for (i = 0; i<n; ++i) printf("%s%d,", (i % 12) ? " " : "\n    ", f(i));
+  printf("\n  };\n\n");
+}
+#else
+/* reference: doAdd() and doSub() as they were in sim.c before alu.h,
+ * on a ram of just ACC and PSW
+ */
+#define ACC 0
+#define PSW 1
+
+#define setBit(x, addr, bit) (*(addr) = (x) ? *(addr) | bit : *(addr) & (BYTE_MASK - (bit)))
+#define setPSW(x, m) setBit(x, ram + PSW, m);
+#define setC(x) setBit(x, ram + PSW, carry)
+#define getC() (ram[PSW] >= carry)
+
+static int ram[2];
+
+/* add value to acc with the proper setting of status registers.
+ * carry is used according to carryFlag but always set afterwards
+ */
+static void doAdd(int value, int carryFlag)
+{
+  int ac = ((ram[ACC] & LO_NYBLE) + (value & LO_NYBLE) + getC()*carryFlag) > LO_NYBLE;
+  int nc = (ram[ACC] + value + (getC()*carryFlag)) > BYTE_MASK;
+  setPSW(ac, auxc);
+  ac = ((ram[ACC] & (BYTE_MASK - BIT7_MASK)) + (value & (BYTE_MASK - BIT7_MASK)) + getC()*carryFlag) > (BYTE_MASK - BIT7_MASK);
+  setPSW(ac ^ nc, ov);
+
+  setC(nc);
+  ram[ACC] = (ram[ACC] + value + getC()*carryFlag) & BYTE_MASK;
+}
+
+/* doSub sub value from acc setting status flags correctly afterwards
+ */
+static void doSub(int value)
+{
+  int ac = ((ram[ACC] & LO_NYBLE) - (value & LO_NYBLE) - getC()) < 0;
+  int nc = (ram[ACC] - value - getC()) < 0;
+
+  setPSW(ac, auxc);
+  ac = ((ram[ACC] & (BYTE_MASK - BIT7_MASK)) - (value & (BYTE_MASK - BIT7_MASK)) - getC()) < 0;
+  setPSW(ac ^ nc, ov); setC(nc);
+  ram[ACC] = (ram[ACC] - value - getC()) & BYTE_MASK;
+}
+
+/* set acc and carry from i, which is aluIndex(c, a, b), and return b
+ */
+static int refInput(int i)
+{
+  ram[ACC] = i/BYTE_MAX % BYTE_MAX;
+  ram[PSW] = (i/BYTE_MAX/BYTE_MAX) ? carry : 0;
+  return i % BYTE_MAX;
+}
+
+/* reference entries, packed as in the tables
+ */
+#define refEntry() aluPack(ram[ACC], (ram[PSW] & auxc) != 0, (ram[PSW] & ov) != 0, getC())
+
+static int refAdd(int i)  { doAdd(refInput(i), FALSE); return refEntry(); }
+static int refAddc(int i) { doAdd(refInput(i), TRUE);  return refEntry(); }
+static int refSubb(int i) { doSub(refInput(i));        return refEntry(); }
+
+/* return number of inputs i < ALU_SIZE for which entry i of table, or f,
+ * is not what the reference ref returns. table has n entries, add_table
+ * has half as there is no carry in
+ */
+static int checkTable(const char *name, const unsigned short *table, int n, 
+		      int (*f)(int), int (*ref)(int))
+{
+  int i, e, r, bad = 0;
+
+  for (i = 0; i<ALU_SIZE; ++i)
+    {
+      e = table[i % n];
+      r = ref(i);
+      if (e != r || f(i) != r || aluResult(e)*BYTE_MAX + aluFlags(e) != e)
+	{
+	  if (!bad++) printf("%s: entry %05X is %d not %d\n", name, i, e, r);
+	}
+    }
+  return bad;
+}
+#endif
+
+int main(void)
+{
+#ifndef ALU_CHECK
+  printf("/* generated by mkalu from alu.h, do not edit */\n\n");
+  writeTable("add_table", "ALU_SIZE/2", ALU_SIZE/2, &addEntry);
+  writeTable("addc_table", "ALU_SIZE", ALU_SIZE, &addcEntry);
+  writeTable("subb_table", "ALU_SIZE", ALU_SIZE, &subbEntry);
+  return 0;
+#else
+  int bad = checkTable("add_table", add_table, ALU_SIZE/2, &addEntry, &refAdd) + 
+    checkTable("addc_table", addc_table, ALU_SIZE, &addcEntry, &refAddc) +
+    checkTable("subb_table", subb_table, ALU_SIZE, &subbEntry, &refSubb);
+
+  printf("alu tables %s\n", (bad) ? "failed" : "okay");
+  return bad != 0;
+#endif
+}
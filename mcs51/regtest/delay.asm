@@ -0,0 +1,19 @@
+	count	equ	30h		; ram counter of a delay loop
+
+start:	mov	r6, #200
+outer:	mov	r7, #250
+inner:	djnz	r7, inner	; delay loops are skipped to their end
+	djnz	r6, outer
+	mov	count, #100
+slow:	djnz	count, slow
+	mov	tmod, #1	; timer 0 16 bit
+	mov	th0, #0F0h	; overflows after 4096 cycles
+	mov	tl0, #0
+	setb	tcon.4
+poll:	mov	a, p1		; poll loops are skipped to the overflow
+	anl	a, #1
+	jnb	tcon.5, poll
+	clr	tcon.4
+	mov	r2, tl0
+	mov	r3, th0
+done:	sjmp	done
@@ -0,0 +1,31 @@
+	nest	equ	30h		; r3 and r4 when external 0 is taken
+
+	org	0
+	ljmp	start
+	org	3		; external interrupt 0
+	ljmp	ext0
+	org	0Bh		; timer 0
+	ljmp	tick0
+
+	org	30h
+start:	mov	sp, #40h
+	mov	tmod, #2	; timer 0 8 bit reload
+	mov	th0, #0C0h	; overflows every 64 cycles
+	mov	tl0, #0C0h
+	mov	ip, #1		; external 0 has high priority
+	mov	ie, #83h	; enable external 0 and timer 0
+	setb	tcon.4		; start timer 0
+wait:	mov	a, r3
+	cjne	a, #4, wait	; wait for 4 timer interrupts
+	clr	tcon.4		; stop timer 0
+done:	sjmp	done
+
+tick0:	inc	r3		; count timer interrupts
+	mov	r4, #25		; long enough for external 0 to nest
+loop:	djnz	r4, loop
+	reti
+
+ext0:	inc	r5		; count external interrupts
+	mov	nest, r3
+	mov	nest+1, r4
+	reti
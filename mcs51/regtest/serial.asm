@@ -0,0 +1,36 @@
+	buf	equ	40h		; bytes received
+
+	org	0
+	ljmp	start
+	org	23h		; serial port
+	ljmp	rxint
+
+	org	30h
+start:	mov	sp, #60h
+	mov	tmod, #20h	; timer 1 8 bit reload
+	mov	th1, #0FDh	; a bit every 96 cycles
+	mov	tl1, #0FDh
+	setb	tcon.6		; start timer 1
+	mov	scon, #50h	; mode 1, receive enabled
+	mov	dptr, #hello
+send:	clr	a
+	movc	a, @a+dptr
+	jz	recv
+	mov	sbuf, a
+wait:	jnb	scon.1, wait	; wait for TI
+	clr	scon.1
+	inc	dptr
+	sjmp	send
+recv:	mov	r0, #buf
+	mov	ie, #90h	; enable serial interrupt
+full:	cjne	r0, #buf+4, full
+	clr	scon.4		; stop receiving
+done:	sjmp	done
+
+rxint:	jnb	scon.0, sret	; a byte received?
+	clr	scon.0
+	mov	@r0, sbuf
+	inc	r0
+sret:	reti
+
+hello:	db	'O', 'K', 0Ah, 0
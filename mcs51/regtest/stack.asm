@@ -0,0 +1,7 @@
+start:	mov	sp, #20h
+	nop
+	pop	acc		; underflows in the middle of a block
+	nop
+	nop
+	nop
+done:	sjmp	done
@@ -0,0 +1,37 @@
+	count	equ	30h		; overflows of timer 1 while timer 0 runs
+
+start:	mov	tmod, #21h	; timer 1 8 bit reload, timer 0 16 bit
+	mov	th1, #0F0h	; timer 1 overflows every 16 cycles
+	mov	tl1, #0F0h
+	mov	th0, #0FFh	; timer 0 overflows after 256 cycles
+	mov	tl0, #0
+	mov	rcap2h, #0FFh	; timer 2 reloads every 256 cycles
+	mov	rcap2l, #0
+	mov	th2, #0FFh
+	mov	tl2, #0
+	setb	t2con.2		; start timer 2
+	setb	tcon.6		; start timer 1
+	setb	tcon.4		; start timer 0
+wait0:	jbc	tcon.7, tick1	; count timer 1 until timer 0 overflows
+	jnb	tcon.5, wait0
+	clr	tcon.4		; stop timer 0
+	mov	r2, tl0		; timer 0 has counted on from 0
+	sjmp	wait2
+tick1:	inc	count
+	sjmp	wait0
+wait2:	jnb	t2con.7, wait2	; timer 2 overflows once
+	clr	t2con.7
+	mov	r3, tl2
+	mov	tmod, #3	; timer 0 as two 8 bit timers
+	mov	th0, #0F8h	; th0 with tr1 sets tf1 after 8 cycles
+	clr	tcon.7
+wait3:	jnb	tcon.7, wait3
+	mov	r4, th0
+	mov	r5, tl0
+	clr	tcon.6		; timer 1 runs without TR1, while timer 0 is in mode 3
+	mov	tmod, #23h
+	mov	tl1, #0
+	nop
+	nop
+	mov	r6, tl1
+done:	sjmp	done
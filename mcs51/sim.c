@@ -22,12 +22,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <assert.h>
+#include <unistd.h>
+#include <poll.h>
 
 #define SIM_CPU_LOCAL
 
 #include "proc.h"
 #include "cpu.h"
+#include "block.h"
+#include "snap.h"
+#include "watch.h"
+#include "event.h"
+#include "alu.h"
+#include "alu_table.h"
 
 const str_storage proc_error_messages[] = { 0 };
 
@@ -37,9 +46,11 @@ const str_storage proc_error_messages[] = { 0 };
  */
 #define atram(x) (ram[((x)>=BYTE_MAX/2) ? (x)+BYTE_MAX/2 : (x)])
 
-/* for bit addrr x, bit has the bit number and addr the byte address
+/* for bit addrr x, bit has the bit number and addr the byte address.
+ * bitByte(x) is the address of the byte alone
  */
-#define bitAddr(x, addr, bit) (bit = 1<<(x % 8), addr = ram + ((x>SGN_BYTE_MAX) ? x & 0xF8 : 0x20 + x/8))
+#define bitByte(x) (ram + ((x>SGN_BYTE_MAX) ? x & 0xF8 : 0x20 + x/8))
+#define bitAddr(x, addr, bit) (bit = 1<<(x % 8), addr = bitByte(x))
 
 /* defintions for PSW */
 
@@ -54,20 +65,60 @@ const str_storage proc_error_messages[] = { 0 };
 #define setC(x) setBit(x, ram + PSW, carry)
 #define getC() (ram[PSW] >= carry)
 
-/* allocation of memory location and SFR's
+/* decoded instructions are allocated a page of code memory at a time
+ * the first time an address in the page is executed
+ */
+#define DECODE_PAGE 256
+
+/* An 8051 is allocated as cpu_ctx by newSim(). Its sim_ctx comes first,
+ * so the sim_ctx* given to the functions below is the cpu_ctx*. Every
+ * function running the cpu has it in cpu, the macros below name its
+ * memory and registers.
+ *
+ * allocation of memory location and SFR's
  * ram is 384 bytes. The first 128 bytes are the joint indirect and direct
  * address space. The next 128 bytes are the SFR accessible by direct address.
  * The last 128 bytes are the upper portion of the indirect adress space
  * use the macro atram to get the correct area
  */
-static int ram[BYTE_MAX+BYTE_MAX/2] = { 0 }; /* internal ram */
-static int xram[MEMORY_MAX] = { 0 };         /* external RAM */
-static int *reg[8];                          /* address of data registers */
-static int stackBase = 7;                    /* base of stack */
+typedef struct
+{
+  sim_ctx sim;                  /* code memory, pc, cycles and blocks */
+  int ram[BYTE_MAX+BYTE_MAX/2]; /* internal ram                       */
+  uint8_t *xram;                /* external RAM                       */
+  int *reg[8];                  /* address of data registers          */
+  int stackBase;                /* base of stack                      */
+  int dptr_value;               /* dptr as returned by getRegister()  */
+  unsigned long long timer_sync; /* cycles the timers are counted to  */
+  int in_service;               /* priorities of interrupts served    */
+  int irq_next;                 /* interrupt taken by next step()     */
+  int tx_fd, rx_fd;             /* host files of the serial port      */
+  char *tx_buf;                 /* bytes sent, not written to tx_fd   */
+  int tx_num;
+  unsigned long long tx_end;    /* cycles the last byte is sent       */
+  unsigned long long tx_write;  /* cycles SBUF was written            */
+  int tx_written;               /* SBUF written, not sent yet         */
+  uint8_t *rx_buf;              /* bytes read from rx_fd, not received */
+  int rx_next, rx_num;
+  int rx_sbuf;                  /* byte received, as SBUF is read     */
+  int rx_wait;                  /* a byte is being received           */
+  struct decode_struct *decode_table[MEMORY_MAX/DECODE_PAGE];
+} cpu_ctx;
+
+#define ram          (cpu->ram)
+#define xram         (cpu->xram)
+#define reg          (cpu->reg)
+#define stackBase    (cpu->stackBase)
+#define decode_table (cpu->decode_table)
+#define memory       (cpu->sim.memory)
+#define pc           (cpu->sim.pc)
+#define reg_gen      (cpu->sim.reg_gen)
+
+#define cpuErr(n) longjmp(*cpu->sim.err, n)
 
 /* add 1 to stack pointer and store value at @Ri address
  */
-static void pushStack(int data)
+static void pushStack(cpu_ctx *cpu, int data)
 {
   if (++(ram[SP]) == (BYTE_MAX-1)) ram[SP] = 0;
   atram(ram[SP]) = data;
@@ -75,21 +126,63 @@ static void pushStack(int data)
 
 /* return value pointed to by stack ponter in @Ri address and decrement
  */
-static int popStack(void)
+static int popStack(cpu_ctx *cpu)
 {
   int value = atram(ram[SP]); --(ram[SP]);
   return value;
 }
 
+/* create an 8051 that runs on code memory mem or its own code memory
+ * (see initCtx())
+ */
+sim_ctx *newSim(uint8_t *mem)
+{
+  cpu_ctx *cpu = NULL;
+
+  safeCalloc(cpu, cpu_ctx, 1);
+  initCtx(&cpu->sim, mem);
+  safeCalloc(xram, uint8_t, MEMORY_MAX);
+  stackBase = 7;
+  cpu->irq_next = UNDEF;
+  cpu->tx_fd = cpu->rx_fd = UNDEF;
+  return &cpu->sim;
+}
+
+/* free the 8051 of s
+ */
+void freeSim(sim_ctx *s)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  int page;
+
+  for (page = 0; page<MEMORY_MAX/DECODE_PAGE; ++page) free(decode_table[page]);
+  if (!s->snap) free(xram);
+  flushSerial(s);
+  free(cpu->tx_buf);
+  free(cpu->rx_buf);
+  freeCtx(s);
+  free(cpu);
+}
+
 /* Put cpu in correct state after reset
  */
-void reset(void)
+void reset(sim_ctx *s)
 {
+  cpu_ctx *cpu = (cpu_ctx*) s;
   int i;
   for (i = 0; i<8; ++i) reg[i] = ram + i;
+  ++reg_gen;
   ram[P0] = ram[P1] = ram[P2] = ram[P3] = BYTE_MASK;
   pc = RESET;
   stackBase = ram[SP] = 7;
+  ram[TCON] = ram[TMOD] = ram[TL0] = ram[TH0] = ram[TL1] = ram[TH1] = 0;
+  ram[T2CON] = ram[RCAP2L] = ram[RCAP2H] = ram[TL2] = ram[TH2] = 0;
+  ram[IE] = ram[IP] = ram[SCON] = ram[SBUF] = ram[PCON] = 0;
+  cpu->in_service = cpu->rx_sbuf = cpu->rx_wait = cpu->tx_written = 0;
+  cpu->tx_end = 0;
+  cpu->irq_next = UNDEF;
+  cpu->sim.cycles = cpu->timer_sync = 0;
+  delEvents(&cpu->sim, UNDEF);
   for (i = 0; i<128; ++i)
     {
       ram[i] = 0;
@@ -97,73 +190,641 @@ void reset(void)
     }
 }
 
-int irq(int i)
+/* clear internal and external ram before reset
+ */
+void powerOn(sim_ctx *s)
 {
-  if (i<0 || i>1) return UNDEF;
-  if (!(ram[IE] & (i*2))) return FALSE;
-  pushStack(getLow(pc));
-  pushStack(getHigh(pc));
-  pc = (i) ? IRQ1 : IRQ0;
-  return TRUE;
+  cpu_ctx *cpu = (cpu_ctx*) s;
+
+  memset(ram, 0, sizeof(ram));
+  memset(xram, 0, MEMORY_MAX);
+  reset(s);
 }
 
+/* PSW bits set by add, addc and subb
+ */
+#define ALU_FLAGS (carry + auxc + ov)
+
 /* add value to acc with the proper setting of status registers.
- * carry is used according to carryFlag but always set afterwards
+ * carry is used according to carryFlag but always set afterwards.
+ * The result is looked up in add_table or addc_table, if acc and value
+ * are bytes
  */
-static void doAdd(int value, int carryFlag)
+static void doAdd(cpu_ctx *cpu, int value, int carryFlag)
 {
-  int ac = ((ram[ACC] & LO_NYBLE) + (value & LO_NYBLE) + getC()*carryFlag) > LO_NYBLE;
-  int nc = (ram[ACC] + value + (getC()*carryFlag)) > BYTE_MASK;
-  setPSW(ac, auxc);
-  ac = ((ram[ACC] & (BYTE_MASK - BIT7_MASK)) + (value & (BYTE_MASK - BIT7_MASK)) + getC()*carryFlag) > (BYTE_MASK - BIT7_MASK);
-  setPSW(ac ^ nc, ov);
-
-  setC(nc);
-  ram[ACC] = (ram[ACC] + value + getC()*carryFlag) & BYTE_MASK;
+  int e;
+  if ((unsigned) (ram[ACC] | value) >= BYTE_MAX)
+    e = aluAdd(ram[ACC], value, getC(), carryFlag);
+  else if (carryFlag)
+    e = addc_table[aluIndex(getC(), ram[ACC], value)];
+  else
+    e = add_table[aluIndex(0, ram[ACC], value)];
+  ram[PSW] = (ram[PSW] & (BYTE_MASK - ALU_FLAGS)) | aluFlags(e);
+  ram[ACC] = aluResult(e);
 }
 
 /* doSub sub value from acc setting status flags correctly afterwards
  */
-static void doSub(int value)
+static void doSub(cpu_ctx *cpu, int value)
 {
-  int ac = ((ram[ACC] & LO_NYBLE) - (value & LO_NYBLE) - getC()) < 0;
-  int nc = (ram[ACC] - value - getC()) < 0;
-
-  setPSW(ac, auxc);
-  ac = ((ram[ACC] & (BYTE_MASK - BIT7_MASK)) - (value & (BYTE_MASK - BIT7_MASK)) - getC()) < 0;
-  setPSW(ac ^ nc, ov); setC(nc);
-  ram[ACC] = (ram[ACC] - value - getC()) & BYTE_MASK;
+  int e;
+  if ((unsigned) (ram[ACC] | value) >= BYTE_MAX)
+    e = aluSubb(ram[ACC], value, getC());
+  else
+    e = subb_table[aluIndex(getC(), ram[ACC], value)];
+  ram[PSW] = (ram[PSW] & (BYTE_MASK - ALU_FLAGS)) | aluFlags(e);
+  ram[ACC] = aluResult(e);
 }
 
-/* after each instr PSW can change. Address of data registers change if
- * rs0 and rs1 are changed. prty bit is on if odd no of bits in acc.
+/* parity of each byte value, 1 if odd no of bits
+ */
+static const int parity_table[BYTE_MAX] =
+  {
+    0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0,
+    1, 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1,
+    1, 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1,
+    0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0,
+    1, 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1,
+    0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0,
+    0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0,
+    1, 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1,
+    1, 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1,
+    0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0,
+    0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0,
+    1, 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1,
+    0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0,
+    1, 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1,
+    1, 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1,
+    0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0
+  };
+
+/* prty bit is on if odd no of bits in acc. It is only brought up to date
+ * before an instruction that uses PSW, before an error and by
+ * syncEvents(), when PSW can be read from outside of the cpu
  */
-static void updatePSW()
+#define updateParity() setPSW(parity_table[ram[ACC] & BYTE_MASK], prty)
+
+/* Address of data registers change if rs0 and rs1 are changed. Only
+ * needed after an instruction that uses PSW or when PSW may have been
+ * changed from outside of the cpu, before syncEvents() starts it again
+ */
+static void updateBank(cpu_ctx *cpu)
 {
-  int i, p, addr = ram[PSW] & (rs1 + rs0);
+  int addr = ram[PSW] & (rs1 + rs0);
   if (reg[0] - ram != addr)
     {
       reg[0] = ram + addr;     reg[1] = ram + addr + 1; 
       reg[2] = ram + addr + 2; reg[3] = ram + addr + 3;
       reg[4] = ram + addr + 4; reg[5] = ram + addr + 5; 
       reg[6] = ram + addr + 6; reg[7] = ram + addr + 7;
+      ++reg_gen;
+    }
+}
+
+/* The timers count machine cycles, as cycles does. Their registers in
+ * ram are only brought up to date by syncTimers(), when an instruction
+ * uses one of the SFRs they depend on or the cpu stops. In between the
+ * count is worked out from the cycles since timer_sync, and the next
+ * overflow that sets a flag is the next event. A timer counting pulses
+ * on its pin (C/T set) has no input and stands still.
+ */
+#define TIMERS 4 /* timer 0, 1, 2 and TH0 as a timer of its own in mode 3 */
+
+/* bits of TCON and T2CON used by the timers
+ */
+#define tf1   0x80
+#define tr1   0x40
+#define tf0   0x20
+#define tr0   0x10
+#define tf2   0x80
+#define rclk  0x20
+#define tclk  0x10
+#define tr2   0x04
+#define ct2   0x02
+#define cprl2 0x01
+
+typedef struct
+{
+  int count;  /* value of the timer                             */
+  int mod;    /* the timer overflows when count reaches mod     */
+  int reload; /* and starts again from reload                   */
+  int rate;   /* counts per cycle                               */
+  int *flag;  /* register with the bit set by overflow, or NULL */
+  int bit;    /* mask of the bit                                */
+} timer_state;
+
+/* get the state of timer n from its registers. Returns FALSE if the
+ * timer is not counting
+ */
+static int getTimer(cpu_ctx *cpu, int n, timer_state *t)
+{
+  int mode = (n == 1) ? ram[TMOD]/16 : ram[TMOD] & LO_NYBLE,
+      lo = (n == 1) ? TL1 : TL0, hi = (n == 1) ? TH1 : TH0;
+
+  t->rate = 1;
+  t->reload = 0;
+  t->flag = ram + TCON;
+  t->bit = (n == 1 || n == 3) ? tf1 : tf0;
+  switch (n)
+    {
+    case 0: case 1: /* gate lets the timer count while its INTn pin is high */
+      if (mode & 4) return FALSE;
+      if (n == 1 && (ram[TMOD] & 3) == 3) /* TR1 and TF1 are TH0's, it runs */
+	t->flag = NULL;
+      else if (!(ram[TCON] & ((n) ? tr1 : tr0)))
+	return FALSE;
+      if ((mode & 8) && !(ram[P3] & ((n) ? 8 : 4))) return FALSE;
+      switch (mode & 3)
+	{
+	case 0: /* 13 bits, the low 5 in TLn */
+	  t->count = ram[hi]*32 + (ram[lo] & 0x1F);
+	  t->mod = 0x2000;
+	  break;
+	case 1:
+	  t->count = ram[hi]*BYTE_MAX + ram[lo];
+	  t->mod = MEMORY_MAX;
+	  break;
+	case 2: /* TLn reloaded from THn */
+	  t->count = ram[lo];
+	  t->mod = BYTE_MAX;
+	  t->reload = ram[hi];
+	  break;
+	case 3: /* timer 1 stops, TL0 and TH0 are two 8 bit timers */
+	  if (n == 1) return FALSE;
+	  t->count = ram[lo];
+	  t->mod = BYTE_MAX;
+	  break;
+	}
+      return TRUE;
+      break;
+    case 2:
+      if (!(ram[T2CON] & tr2) || (ram[T2CON] & ct2)) return FALSE;
+      t->count = ram[TH2]*BYTE_MAX + ram[TL2];
+      t->mod = MEMORY_MAX;
+      t->flag = ram + T2CON;
+      t->bit = tf2;
+      if (ram[T2CON] & (rclk + tclk)) /* baud rate generator at osc/2 */
+	{
+	  t->rate = 6;
+	  t->flag = NULL;
+	}
+      if (t->flag == NULL || !(ram[T2CON] & cprl2))
+	t->reload = ram[RCAP2H]*BYTE_MAX + ram[RCAP2L];
+      return TRUE;
+      break;
+    default: /* TH0 in mode 3 runs with TR1 */
+      if ((ram[TMOD] & 3) != 3 || !(ram[TCON] & tr1)) return FALSE;
+      t->count = ram[TH0];
+      t->mod = BYTE_MAX;
+      return TRUE;
+      break;
+    }
+}
+
+/* store count of timer n in its registers
+ */
+static void setTimer(cpu_ctx *cpu, int n, int count)
+{
+  int mode = (n == 1) ? ram[TMOD]/16 : ram[TMOD] & LO_NYBLE,
+      lo = (n == 1) ? TL1 : TL0, hi = (n == 1) ? TH1 : TH0;
+
+  if (n == 2)
+    {
+      ram[TH2] = getHigh(count);
+      ram[TL2] = getLow(count);
+    }
+  else if (n == 3)
+    ram[TH0] = count;
+  else if ((mode & 3) == 0)
+    {
+      ram[hi] = count/32;
+      ram[lo] = (ram[lo] & 0xE0) + count%32;
+    }
+  else if ((mode & 3) == 1)
+    {
+      ram[hi] = getHigh(count);
+      ram[lo] = getLow(count);
+    }
+  else
+    ram[lo] = count;
+}
+
+/* count the timers up to cycle now. An overflow sets the flag of the
+ * timer, any number of them in between is the same
+ */
+static void syncTimers(cpu_ctx *cpu, unsigned long long now)
+{
+  timer_state t;
+  unsigned long long counts;
+  int n;
+
+  if (now<=cpu->timer_sync) return;
+  for (n = 0; n<TIMERS; ++n)
+    {
+      if (!getTimer(cpu, n, &t)) continue;
+      counts = (now - cpu->timer_sync)*t.rate;
+      if (counts<t.mod - t.count)
+	t.count += counts;
+      else
+	{
+	  t.count = t.reload + (counts - (t.mod - t.count)) % (t.mod - t.reload);
+	  if (t.flag) *t.flag |= t.bit;
+	}
+      setTimer(cpu, n, t.count);
+    }
+  cpu->timer_sync = now;
+}
+
+/* the next event is the first overflow that sets a flag. Once it is
+ * set, an overflow only changes the count, which is worked out when
+ * it is read
+ */
+static void scheduleTimers(cpu_ctx *cpu)
+{
+  timer_state t;
+  unsigned long long due;
+  int n;
+
+  delEvents(&cpu->sim, EVENT_TIMER);
+  for (n = 0; n<TIMERS; ++n)
+    {
+      if (!getTimer(cpu, n, &t) || !t.flag || (*t.flag & t.bit)) continue;
+      due = cpu->timer_sync + (t.mod - t.count + t.rate - 1)/t.rate;
+      addEvent(&cpu->sim, due, EVENT_TIMER, n);
+    }
+}
+
+/* The serial port shifts a byte out or in during the cycles of a frame
+ * at the baud rate of its mode. A byte written to SBUF is sent to tx_fd
+ * and sets TI at the end of its frame. While REN is set and RI is clear,
+ * the next byte of rx_fd is received into SBUF and sets RI at the end
+ * of its frame. The bytes are buffered, so that the host files are
+ * written a line or SERIAL_BUF bytes at a time and read up to
+ * SERIAL_BUF bytes at a time. The 9th bit of modes 2 and 3 is not sent
+ * and RB8 is set, as by a stop bit.
+ */
+#define SERIAL_BUF 4096
+#define SERIAL_TX  0  /* value of EVENT_SERIAL that sets TI          */
+#define SERIAL_RX  1  /* value of EVENT_SERIAL that receives a byte  */
+#define RX_IDLE    16 /* frames before rx_fd is polled again if idle */
+
+/* bits of SCON and PCON
+ */
+#define sm0  0x80
+#define sm1  0x40
+#define ren  0x10
+#define rb8  0x04
+#define ti   0x02
+#define ri   0x01
+#define smod 0x80
+
+/* return the cycles of a frame of the serial port or 0, if its baud
+ * rate timer is stopped. clk is the bit of T2CON that selects timer 2
+ * as the baud rate timer in modes 1 and 3, tclk or rclk
+ */
+static unsigned long long frameCycles(cpu_ctx *cpu, int clk)
+{
+  timer_state t;
+  int div = (ram[PCON] & smod) ? 1 : 2, bits = (ram[SCON] & sm0) ? 11 : 10, n;
+
+  switch (ram[SCON] & (sm0 + sm1))
+    {
+    case 0: /* mode 0 shifts 8 bits at one bit a cycle */
+      return 8;
+      break;
+    case sm0: /* mode 2 at osc/64 or osc/32, 12 osc a cycle */
+      return (bits*32*div + 11)/12;
+      break;
+    }
+  if (ram[T2CON] & clk) /* a bit takes 16 overflows of timer 2 */
+    {
+      if (!getTimer(cpu, 2, &t)) return 0;
+      n = 16;
+    }
+  else /* or 32 of timer 1, 16 if SMOD is set */
+    {
+      if (!getTimer(cpu, 1, &t)) return 0;
+      n = 16*div;
+    }
+  return (bits*n*(unsigned long long) (t.mod - t.reload) + t.rate - 1)/t.rate;
+}
+
+/* write the bytes sent to tx_fd. They are lost if it has been closed
+ */
+static void flushTx(cpu_ctx *cpu)
+{
+  int i, n;
+
+  for (i = 0; i<cpu->tx_num; i += n)
+    if ((n = write(cpu->tx_fd, cpu->tx_buf + i, cpu->tx_num - i))<=0) break;
+  cpu->tx_num = 0;
+}
+
+/* SBUF was written by an instruction at cycles tx_write. Send the byte
+ * written after the one being sent, SBUF is read as the byte received
+ */
+static void transmit(cpu_ctx *cpu)
+{
+  unsigned long long frame = frameCycles(cpu, tclk), now = cpu->tx_write;
+  int byte = ram[SBUF];
+
+  ram[SBUF] = cpu->rx_sbuf;
+  cpu->tx_written = FALSE;
+  if (!frame) return;
+  cpu->tx_end = ((cpu->tx_end>now) ? cpu->tx_end : now) + frame;
+  addEvent(&cpu->sim, cpu->tx_end, EVENT_SERIAL, SERIAL_TX);
+  if (cpu->tx_fd == UNDEF) return;
+  cpu->tx_buf[cpu->tx_num++] = byte;
+  if (byte == '\n' || cpu->tx_num == SERIAL_BUF) flushTx(cpu);
+}
+
+/* return TRUE if there is a byte to be received. rx_fd is only read,
+ * if it has bytes ready and none are left in rx_buf
+ */
+static int readRx(cpu_ctx *cpu)
+{
+  struct pollfd p;
+  int n;
+
+  if (cpu->rx_next<cpu->rx_num) return TRUE;
+  if (cpu->rx_fd == UNDEF) return FALSE;
+  p.fd = cpu->rx_fd;
+  p.events = POLLIN;
+  if (poll(&p, 1, 0)<=0) return FALSE;
+  if ((n = read(cpu->rx_fd, cpu->rx_buf, SERIAL_BUF))<=0) 
+    {
+      cpu->rx_fd = UNDEF; /* end of input */
+      return FALSE;
+    }
+  cpu->rx_next = 0;
+  cpu->rx_num = n;
+  return TRUE;
+}
+
+/* start receiving the next byte, if the serial port can. If none is
+ * ready yet, rx_fd is looked at again after RX_IDLE frames
+ */
+static void scheduleRx(cpu_ctx *cpu)
+{
+  unsigned long long frame;
+
+  if (cpu->rx_wait || !(ram[SCON] & ren) || (ram[SCON] & ri)) return;
+  if (cpu->rx_fd == UNDEF && cpu->rx_next == cpu->rx_num) return;
+  if (!(frame = frameCycles(cpu, rclk))) return;
+  if (!readRx(cpu)) frame *= RX_IDLE;
+  addEvent(&cpu->sim, cpu->sim.cycles + frame, EVENT_SERIAL, SERIAL_RX);
+  cpu->rx_wait = TRUE;
+}
+
+/* the frame of EVENT_SERIAL value has ended
+ */
+static void serialEvent(cpu_ctx *cpu, int value)
+{
+  if (value == SERIAL_TX)
+    {
+      ram[SCON] |= ti;
+      return;
+    }
+  cpu->rx_wait = FALSE;
+  if (!(ram[SCON] & ren) || (ram[SCON] & ri) || !readRx(cpu)) return;
+  ram[SBUF] = cpu->rx_sbuf = cpu->rx_buf[cpu->rx_next++];
+  ram[SCON] |= ri + rb8;
+}
+
+int setSerial(sim_ctx *s, int out, int in)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+
+  flushSerial(s);
+  if (!cpu->tx_buf) safeMalloc(cpu->tx_buf, char, SERIAL_BUF);
+  if (!cpu->rx_buf) safeMalloc(cpu->rx_buf, uint8_t, SERIAL_BUF);
+  cpu->tx_fd = out;
+  cpu->rx_fd = in;
+  cpu->rx_next = cpu->rx_num = 0;
+  return TRUE;
+}
+
+void flushSerial(sim_ctx *s)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+
+  if (cpu->tx_fd != UNDEF && cpu->tx_num) flushTx(cpu);
+}
+
+/* Interrupt sources in the order they are polled. Each is requested
+ * by one of its flags in sfr, and enabled and given high priority by
+ * its bit in IE and IP. Taking the interrupt is a lcall to vector. An
+ * interrupt is only taken while none of its priority or higher is being
+ * served, until the reti of that one. irq() numbers them by number,
+ * the external interrupts 0 and 1 come first.
+ */
+typedef struct
+{
+  int sfr;    /* register with the flags              */
+  int flags;  /* flags requesting the interrupt       */
+  int flag;   /* flag set by irq()                    */
+  int clear;  /* flags cleared when it is taken       */
+  int enable; /* bit in IE and IP                     */
+  int vector; /* address of the interrupt routine     */
+  int number; /* number of the interrupt for irq()    */
+} irq_source;
+
+#define IRQS 6
+#define ea 0x80            /* bit in IE that enables all interrupts */
+#define serial_enable 0x10 /* and the one of the serial port         */
+
+static const irq_source irq_table[IRQS] =
+  {
+    { TCON,  0x02, 0x02, 0x02, 0x01, IRQ0,   0 },
+    { TCON,  tf0,  tf0,  tf0,  0x02, TIMER0, 2 },
+    { TCON,  0x08, 0x08, 0x08, 0x04, IRQ1,   1 },
+    { TCON,  tf1,  tf1,  tf1,  0x08, TIMER1, 3 },
+    { SCON,  ti+ri, ri,  0,    serial_enable, SERIAL, 4 },
+    { T2CON, 0xC0, tf2,  0,    0x20, TIMER2, 5 }
+  };
+
+/* bit in IE of the interrupt of each timer
+ */
+static const int timer_enable[TIMERS] = { 0x02, 0x08, 0x20, 0x08 };
+
+/* return source in irq_table of the interrupt number or UNDEF
+ */
+static int irqSource(int number)
+{
+  int i;
+  for (i = 0; i<IRQS; ++i) if (irq_table[i].number == number) return i;
+  return UNDEF;
+}
+
+/* return the interrupt source to be taken now or UNDEF. A requested
+ * interrupt of high priority comes before one of low priority
+ */
+static int pendingIrq(cpu_ctx *cpu)
+{
+  int i, found = UNDEF;
+
+  if (!(ram[IE] & ea) || (cpu->in_service & 2)) return UNDEF;
+  for (i = 0; i<IRQS; ++i)
+    {
+      if (!(ram[irq_table[i].sfr] & irq_table[i].flags) || !(ram[IE] & irq_table[i].enable)) 
+	continue;
+      if (ram[IP] & irq_table[i].enable) return i;
+      if (found == UNDEF && !cpu->in_service) found = i;
+    }
+  return found;
+}
+
+/* take interrupt source i
+ */
+static void vectorIrq(cpu_ctx *cpu, int i)
+{
+  pushStack(cpu, getLow(pc));
+  pushStack(cpu, getHigh(pc));
+  ram[irq_table[i].sfr] &= BYTE_MASK - irq_table[i].clear;
+  cpu->in_service |= (ram[IP] & irq_table[i].enable) ? 2 : 1;
+  cpu->sim.cycles += 2; /* interrupt is a lcall to its vector */
+  pc = irq_table[i].vector;
+  cpu->irq_next = UNDEF;
+}
+
+/* set the flag requesting interrupt number i, FALSE if there is none
+ */
+static int raiseIrq(cpu_ctx *cpu, int i)
+{
+  if ((i = irqSource(i)) == UNDEF) return FALSE;
+  ram[irq_table[i].sfr] |= irq_table[i].flag;
+  return TRUE;
+}
+
+/* TRUE if i is the number of an interrupt in irq_table
+ */
+int isIrq(sim_ctx *s, int i)
+{
+  return irqSource(i) != UNDEF;
+}
+
+/* request interrupt number i. It is taken now, if it can be, or stays
+ * requested by its flag
+ */
+int irq(sim_ctx *s, int i)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+
+  if (!raiseIrq(cpu, i)) return UNDEF;
+  if ((cpu->irq_next = pendingIrq(cpu)) == UNDEF) return FALSE;
+  vectorIrq(cpu, cpu->irq_next);
+  return TRUE;
+}
+
+/* an interrupt can only be taken while all interrupts are enabled and
+ * one of them is requested or will be by an event
+ */
+int canInterrupt(sim_ctx *s)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  const event_struct *e;
+  int i, n, src, enable;
+
+  if (!(ram[IE] & ea)) return FALSE;
+  if (pendingIrq(cpu) != UNDEF) return TRUE;
+  for (e = getEvents(s, &n), i = 0; i<n; ++i)
+    {
+      switch (e[i].kind)
+	{
+	case EVENT_TIMER:
+	  enable = timer_enable[e[i].value];
+	  break;
+	case EVENT_SERIAL: /* nothing is received while REN is clear */
+	  enable = (e[i].value == SERIAL_RX && !(ram[SCON] & ren)) ? 0 : serial_enable;
+	  break;
+	default:
+	  src = irqSource(e[i].value);
+	  enable = (src == UNDEF) ? 0 : irq_table[src].enable;
+	  break;
+	}
+      if (ram[IE] & enable) return TRUE;
     }
-  p = 0;
-  for (i=BIT7_MASK; i; i /= 2) { p += ((ram[ACC] & i) != 0); }
-  setPSW(p & 1, prty);
+  return FALSE;
+}
+
+/* SFRs the timers depend on. An instruction with one of them as a
+ * parameter brings the timers up to date before it executes
+ */
+static const int timer_sfrs[] = 
+  { TCON, TMOD, TL0, TL1, TH0, TH1, P3, T2CON, RCAP2L, RCAP2H, TL2, TH2 };
+
+static int isTimerSfr(cpu_ctx *cpu, const int *p)
+{
+  int i;
+  for (i = 0; i<sizeof(timer_sfrs)/sizeof(int); ++i) if (p == ram + timer_sfrs[i]) return TRUE;
+  return FALSE;
 }
 
-/* Get param will calculate the parameters from the cpu_instr_tkn[op] entry
+/* kinds of decoded parameters. A static parameter is resolved to its
+ * address in ram when the instruction is decoded, #data is copied from
+ * code memory. The other kinds depend on the state of the cpu when the
+ * instruction executes.
+ */
+enum param_kind
+  {
+    static_param, reg_param, atr_param, movx_param, 
+    atdptr_param, adptr_param, apc_param
+  };
+
+/* decoded parameter of an instruction
+ */
+typedef struct
+{
+  int kind; /* enum param_kind                          */
+  int n;    /* register number for r0-r7, @r0 and @r1   */
+  int *p;   /* address of static parameter              */
+  int bit;  /* bit mask of bit addr, negative if /bit    */
+  int imm[2]; /* #data_8 or #data_16, p points to it     */
+} param_struct;
+
+/* decoded instruction. Decoding walks cpu_instr_tkn[op] once, so step()
+ * only has to resolve the parameters that depend on the state of the cpu.
+ */
+typedef struct decode_struct
+{
+  int valid;             /* FALSE if instruction must be decoded again */
+  int flags;             /* psw_used, sp_used                          */
+  int op;                /* opcode                                     */
+  int instr;             /* instruction token, selects handler in step */
+  int bytes;             /* length of instruction in bytes             */
+  int left;              /* cycles of the instrs after it in its block */
+  int addr;              /* value of addr_11, addr_16 or rel_addr      */
+  param_struct param[2]; /* destination and source parameter           */
+} decode_struct;
+
+/* flags of a decoded instruction. psw_used if a parameter is PSW or one
+ * of its bits, sp_used if it changes SP by a parameter, push or pop,
+ * timer_used if a parameter is one of the timer_sfrs, irq_used if it
+ * writes one of the irq_sfrs or is a reti, so that an interrupt may be
+ * taken after it, and serial_used if it writes SBUF
+ */
+#define psw_used    1
+#define sp_used     2
+#define timer_used  4
+#define irq_used    8
+#define serial_used 16
+
+static const int irq_sfrs[] = { IE, IP, TCON, SCON, T2CON, SBUF };
+
+static int paramKind(const decode_struct*, int);
+
+/* decodeParam will decode the parameters from the cpu_instr_tkn[op] entry
  * *index points to the first parameter of the opcode, and *code points
  * to the next byte in code memory after the opcode
  * 
- * if reg or memory parameter found, *param is set to address of memory or reg
+ * if reg or memory parameter found, *param is set to its kind and address
  * if regular addr found, *addr set to this value
- * if bit addr found, *param will have addr of byte, and bparam has bit num
+ * if bit addr found, param will have addr of byte and bit mask
  */
-static int getParam(int op, const int **index, int **code, int **param, int *bparam, int *addr)
+static int decodeParam(cpu_ctx *cpu, int op, const int **index, uint8_t **code,
+		       param_struct *param, int *addr)
 {
-  int inv = 1, *p = NULL, bp = UNDEF;
+  int inv = 1, n = 0, kind = static_param, *p = NULL, bp = UNDEF;
 
   switch (**index)
     {
@@ -182,8 +843,13 @@ static int getParam(int op, const int **index, int **code, int **param, int *bpa
     case rel_addr:
       *addr = **code;
       break;      
-    case pound: /* code in memory is the source of the move */
-      p = *code;
+    case pound: /* copy of code in memory is the source of the move */
+      if (param)
+	{
+	  param->imm[0] = **code;
+	  param->imm[1] = (*code + 1<memory + MEMORY_MAX) ? (*code)[1] : 0;
+	  p = param->imm;
+	}
       ++*index;
       break;
     case slash: /* negative bit addr will indicate inverse bit */
@@ -194,20 +860,18 @@ static int getParam(int op, const int **index, int **code, int **param, int *bpa
       bp *= inv;
       break;
     case a_dptr:
-      *addr = ram[DPL] + ram[DPH]*BYTE_MAX + ram[ACC];
+      kind = adptr_param;
       break;
     case a_pc:
-      *addr = pc + ram[ACC];
+      kind = apc_param;
       break;
     case at_dptr:
-      p = xram + ram[DPL] + ram[DPH]*BYTE_MAX;
+      kind = atdptr_param;
       break;
     case at_r0:
     case at_r1:
-      if (cpu_instr_tkn[op][INSTR_TKN_INSTR]==movx) 
-	p = xram + ram[P2]*BYTE_MAX + *reg[**index - at_r0];
-      else
-	p = &atram(*reg[**index - at_r0]);
+      kind = (cpu_instr_tkn[op][INSTR_TKN_INSTR]==movx) ? movx_param : atr_param;
+      n = **index - at_r0;
       break;
     case a:
       p = ram + ACC;
@@ -220,7 +884,8 @@ static int getParam(int op, const int **index, int **code, int **param, int *bpa
       break;
     case r0: case r1: case r2: case r3:
     case r4: case r5: case r6: case r7:
-      p = reg[**index - r0];
+      kind = reg_param;
+      n = **index - r0;
       break;
     default:
       assert(TRUE);
@@ -229,34 +894,142 @@ static int getParam(int op, const int **index, int **code, int **param, int *bpa
   /* if token is constant, it will have be encoded in memory, adv codeptr
    */
   if (isConstToken(**index)) ++(*code); *index += 2;
-  if (bparam) *bparam = bp; if (param) *param = p; /* don't assign if NULL */
+  if (param) /* don't assign if NULL */
+    {
+      param->kind = kind; param->n = n; param->p = p; param->bit = bp;
+    }
   return TRUE;
 }
 
-/* step() is the master function to update the registers and memory 
- * from the execution of the opcode at memory[pc]
+/* decode the instruction at code address addr into d
  */
-void step(void)
+static void decode(cpu_ctx *cpu, int addr, decode_struct *d)
 {
-  int x, y, *src = NULL, *dst = NULL, bsrc = UNDEF, bdst = UNDEF, addr = 0,
-      op = memory[pc], opcode = cpu_instr_tkn[op][INSTR_TKN_INSTR],
-      *code = memory + pc + 1, *tmp;
-  const int *index = cpu_instr_tkn[op] + INSTR_TKN_PARAM;
-  
-  /* value of pc during instr execution is pc of next instr
-   * return immediately if pc has overflowed (let sim register error)
-   */
-  pc += cpu_instr_tkn[memory[pc]][INSTR_TKN_BYTES];
-  if (pc>=MEMORY_MAX) { pc = 0; longjmp(err, pc_overflow); }
+  int i, j;
+  uint8_t *code = memory + addr + 1;
+  const int *index;
 
-  /* Look for up to 3 parameters in opcdoe. getParam will 
+  d->op    = memory[addr];
+  d->instr = cpu_instr_tkn[d->op][INSTR_TKN_INSTR];
+  d->bytes = cpu_instr_tkn[d->op][INSTR_TKN_BYTES];
+  d->addr  = 0;
+  d->left  = 0;
+  for (i = 0; i<2; ++i)
+    {
+      d->param[i].kind = static_param; d->param[i].p = NULL; d->param[i].bit = UNDEF;
+    }
+
+  /* Look for up to 3 parameters in opcdoe. decodeParam will 
    * return 0 if no more paramaters to be found.
    * 1st param dest reg or memory, 2nd param source or addr, 
    * 3rd param always address
    */
-  getParam(op, &index, &code, &dst, &bdst, &addr) &&
-  getParam(op, &index, &code, &src, &bsrc, &addr) &&
-  getParam(op, &index, &code, NULL, NULL,  &addr);
+  index = cpu_instr_tkn[d->op] + INSTR_TKN_PARAM;
+  decodeParam(cpu, d->op, &index, &code, d->param, &d->addr) &&
+  decodeParam(cpu, d->op, &index, &code, d->param + 1, &d->addr) &&
+  decodeParam(cpu, d->op, &index, &code, NULL, &d->addr);
+
+  d->flags = 0;
+  for (i = 0; i<2; ++i)
+    {
+      if (d->param[i].p == ram + PSW) d->flags |= psw_used;
+      if (d->param[i].p == ram + SP)  d->flags |= sp_used;
+      if (isTimerSfr(cpu, d->param[i].p)) d->flags |= timer_used;
+      for (j = 0; j<sizeof(irq_sfrs)/sizeof(int); ++j)
+	if (d->param[i].p == ram + irq_sfrs[j] && (paramKind(d, i) & WATCH_WRITE)) 
+	  d->flags |= (irq_sfrs[j] == SBUF) ? irq_used + serial_used : irq_used;
+    }
+  switch (d->instr)
+    {
+    case acall: case acdup: case lcall: case push: case pop: case ret: case reti:
+      d->flags |= sp_used;
+      break;
+    }
+  if (d->instr == reti) d->flags |= irq_used;
+  d->valid = TRUE;
+}
+
+/* return decoded instruction at code address addr, decoding it if needed
+ */
+static decode_struct *getDecode(cpu_ctx *cpu, int addr)
+{
+  decode_struct **page = decode_table + addr/DECODE_PAGE, *d;
+
+  if (!*page) safeCalloc(*page, decode_struct, DECODE_PAGE);
+  d = *page + addr%DECODE_PAGE;
+  if (!d->valid) decode(cpu, addr, d);
+  return d;
+}
+
+/* code memory at addr is about to be written. Any decoded instruction
+ * (at most 3 bytes long) that contains addr has to be decoded again.
+ */
+static void invalidateDecode(cpu_ctx *cpu, int addr)
+{
+  int i;
+  for (i = addr - 2; i<=addr; ++i)
+    {
+      if (i>=0 && decode_table[i/DECODE_PAGE]) 
+	decode_table[i/DECODE_PAGE][i%DECODE_PAGE].valid = FALSE;
+    }
+}
+
+/* getParam will return the address of a decoded parameter for the
+ * current state of the cpu. *bit is set to the bit mask of a bit parameter
+ * and *addr is set for the @a+dptr and @a+pc parameters and to the
+ * address in xram of the movx parameters.
+ */
+static int *getParam(cpu_ctx *cpu, const param_struct *param, int *bit, int *addr)
+{
+  *bit = param->bit;
+  switch (param->kind)
+    {
+    case reg_param:
+      return reg[param->n];
+      break;
+    case atr_param:
+      return &atram(*reg[param->n]);
+      break;
+    case movx_param:
+      *addr = ram[P2]*BYTE_MAX + *reg[param->n];
+      return NULL;
+      break;
+    case atdptr_param:
+      *addr = ram[DPL] + ram[DPH]*BYTE_MAX;
+      return NULL;
+      break;
+    case adptr_param: /* the sum wraps around in 16 bits */
+      *addr = (ram[DPL] + ram[DPH]*BYTE_MAX + ram[ACC]) & 0xFFFF;
+      return NULL;
+      break;
+    case apc_param:
+      *addr = (pc + ram[ACC]) & 0xFFFF;
+      return NULL;
+      break;
+    default:
+      return param->p;
+      break;
+    }
+}
+
+/* exec() is the master function to update the registers and memory 
+ * from the execution of the decoded instruction at pc
+ */
+static void exec(cpu_ctx *cpu, const decode_struct *d)
+{
+  int x, y, *src, *dst, bsrc, bdst, *tmp,
+      op = d->op, opcode = d->instr, addr = d->addr;
+  
+  /* value of pc during instr execution is pc of next instr
+   * return immediately if pc has overflowed (let sim register error)
+   */
+  pc += d->bytes;
+  if (pc>=MEMORY_MAX) { pc = 0; updateParity(); cpu->sim.cycles -= d->left; cpuErr(pc_overflow); }
+
+  dst = getParam(cpu, d->param, &bdst, &addr);
+  src = getParam(cpu, d->param + 1, &bsrc, &addr);
+  if (d->flags & psw_used) updateParity();
+  if (d->flags & timer_used) syncTimers(cpu, cpu->sim.cycles - d->left);
 
   /* calls to getparam will set dst, src registers or memory locations
    * plus any address. switch statment acts on these values
@@ -264,14 +1037,14 @@ void step(void)
   switch (opcode)
     {
     case acdup: case acall: /* acall addr_11 */
-      pushStack(getLow(pc));
-      pushStack(getHigh(pc));
+      pushStack(cpu, getLow(pc));
+      pushStack(cpu, getHigh(pc));
     case ajdup: case ajmp: /* ajmp addr_11 */
       pc = (pc & 0xF800) + addr;
       break;
     case add:  /* add  dst, src */
     case addc: /* addc dst, src */
-      doAdd(*src, (opcode - add) ? TRUE : FALSE);
+      doAdd(cpu, *src, (opcode - add) ? TRUE : FALSE);
       break;
     case anl: /* anl dst, src */
       if (bdst != UNDEF) /* anl dst.bdst, src.bsrc */
@@ -296,8 +1069,8 @@ void step(void)
 	*dst ^= BYTE_MASK;
       break;
     case da: /* da a */
-      if ((ram[ACC] & LO_NYBLE)>0x09 || (ram[PSW] | auxc)>0) doAdd(0x06, FALSE);
-      if ((ram[ACC] & HI_NYBLE)>0x90 || getC())              doAdd(0x60, FALSE);
+      if ((ram[ACC] & LO_NYBLE)>0x09 || (ram[PSW] | auxc)>0) doAdd(cpu, 0x06, FALSE);
+      if ((ram[ACC] & HI_NYBLE)>0x90 || getC())              doAdd(cpu, 0x60, FALSE);
       break;
     case dec: /* dec dst */
       dec(*dst);
@@ -342,15 +1115,21 @@ void step(void)
       if (!(ram[ACC])) relJmp(pc, addr);
       break;
     case lcall: /* lcall addr_16 */
-      pushStack(getLow(pc));
-      pushStack(getHigh(pc));
+      pushStack(cpu, getLow(pc));
+      pushStack(cpu, getHigh(pc));
     case jmp:  /* jmp @a+dptr */
     case ljmp: /* ljmp addr_16 */
       pc = addr;
       break;
+    case movx: /* movx dst, src, the one in xram is at addr */
+      if (dst)
+	*dst = xram[addr];
+      else
+	xram[addr] = *src;
+      break;
     case movc: /* movc src, addr_16 */
-      src = memory + addr;
-    case movx: case mov: /* mov dst, src */
+      x = memory[addr]; src = &x;
+    case mov: /* mov dst, src */
       if (op == 0x85)
 	{
 	  tmp = src;
@@ -384,13 +1163,14 @@ void step(void)
 	*dst |= *src;
       break;
     case pop: /* pop addr_8 */
-      *dst = popStack();
+      *dst = popStack(cpu);
       break;
     case push:  /* push addr_8 */
-      pushStack(*dst);
+      pushStack(cpu, *dst);
       break;
     case reti: case ret: /* reti, OR ret */
-      pc = popStack()*BYTE_MAX + popStack();
+      pc = popStack(cpu)*BYTE_MAX + popStack(cpu);
+      if (opcode == reti) cpu->in_service &= (cpu->in_service & 2) ? 1 : 0;
       break;
     case rl: /* rl a */
       ram[ACC] = ((ram[ACC])*2 + (ram[ACC]>=BIT7_MASK)) & BYTE_MASK;
@@ -416,7 +1196,7 @@ void step(void)
       relJmp(pc, addr);
       break;
     case subb: /* subb a, dst */
-      doSub(*src);
+      doSub(cpu, *src);
       break;
     case swap: /* swap a */
       ram[ACC] = (ram[ACC] & LO_NYBLE)*0x10 + ram[ACC]/0x10;
@@ -439,15 +1219,414 @@ void step(void)
       assert(TRUE);
       break;
     }
-  updatePSW();
-  if (ram[SP]<stackBase) longjmp(err, stack_underflow);
+  if (d->flags & psw_used) updateBank(cpu);
+  if (d->flags & timer_used) scheduleTimers(cpu);
+  if (d->flags & serial_used)
+    {
+      cpu->tx_write = cpu->sim.cycles - d->left; /* sent by syncEvents() */
+      cpu->tx_written = TRUE;
+    }
+  if (d->flags & irq_used) cpu->sim.next_event = 0; /* see syncEvents() */
+  if ((d->flags & sp_used) && ram[SP]<stackBase)
+    {
+      updateParity();
+      cpu->sim.cycles -= d->left; /* block's cycles are added before it */
+      cpuErr(stack_underflow);
+    }
+}
+
+/* a location an instruction accesses, see watchExec()
+ */
+#define WATCH_LOCS 12
+
+typedef struct
+{
+  int area;  /* WATCH_RAM, WATCH_XRAM or WATCH_MEM             */
+  int index; /* index in area                                  */
+  int kind;  /* WATCH_READ, WATCH_WRITE or 0 if only a change */
+  int old;   /* value before the instruction                  */
+} watch_loc;
+
+static int locValue(cpu_ctx *cpu, const watch_loc *l)
+{
+  switch (l->area)
+    {
+    case WATCH_RAM:  return ram[l->index];
+    case WATCH_XRAM: return xram[l->index];
+    default:         return memory[l->index];
+    }
+}
+
+/* add location index of area to the n in locs, if its page is watched
+ */
+static void addLoc(cpu_ctx *cpu, watch_loc *locs, int *n, int area, int index, int kind)
+{
+  int i;
+
+  if (!isWatched(&cpu->sim, area, index, WATCH_READ | WATCH_WRITE)) return;
+  for (i = 0; i<*n; ++i)
+    {
+      if (locs[i].area != area || locs[i].index != index) continue;
+      locs[i].kind |= kind;
+      return;
+    }
+  locs[*n].area = area;
+  locs[*n].index = index;
+  locs[*n].kind = kind;
+  locs[*n].old = locValue(cpu, locs + *n);
+  ++*n;
+}
+
+/* how the instruction accesses parameter i
+ */
+static int paramKind(const decode_struct *d, int i)
+{
+  switch (d->instr)
+    {
+    case cjne: case jb: case jnb: case push:
+      return WATCH_READ;
+    case mov: /* mov addr_8, addr_8 has src & dst reversed */
+      return (i == (d->op != 0x85)) ? WATCH_READ : WATCH_WRITE;
+    case movc: case movx: case pop: case clr: case setb:
+      return (i) ? WATCH_READ : WATCH_WRITE;
+    case xch: case xchd:
+      return WATCH_READ | WATCH_WRITE;
+    default:
+      return (i) ? WATCH_READ : WATCH_READ | WATCH_WRITE;
+    }
+}
+
+/* exec() an instruction, while there are watches. Its parameters, the
+ * xram or code byte of movx and movc, the stack and the sfrs changed on
+ * their own are the locations it accesses. The ones in watched pages
+ * are saved and checked after it. A sfr it does not have as parameter
+ * is only seen when it changes
+ */
+static void watchExec(cpu_ctx *cpu, const decode_struct *d)
+{
+  static const int sfrs[] = { ACC, B, PSW, SP, DPL, DPH };
+  watch_loc locs[WATCH_LOCS];
+  int *p[2], i, n = 0, bit, addr = d->addr, sp = ram[SP], value;
+
+  pc += d->bytes; /* parameters are taken as exec() does */
+  for (i = 0; i<2; ++i)
+    {
+      p[i] = getParam(cpu, d->param + i, &bit, &addr);
+      if (p[i]>=ram && p[i]<ram + sizeof(ram)/sizeof(int))
+	addLoc(cpu, locs, &n, WATCH_RAM, p[i] - ram, paramKind(d, i));
+    }
+  pc -= d->bytes;
+  switch (d->instr)
+    {
+    case movx:
+      addLoc(cpu, locs, &n, WATCH_XRAM, addr, (p[0]) ? WATCH_READ : WATCH_WRITE);
+      break;
+    case movc:
+      addLoc(cpu, locs, &n, WATCH_MEM, addr, WATCH_READ);
+      break;
+    case acdup: case acall: case lcall: case push: /* as pushStack() */
+      for (i = (d->instr == push) ? 1 : 0; i<2; ++i)
+	{
+	  if (++sp == BYTE_MAX-1) sp = 0;
+	  addLoc(cpu, locs, &n, WATCH_RAM, &atram(sp) - ram, WATCH_WRITE);
+	}
+      break;
+    case ret: case reti: case pop: /* as popStack() */
+      for (i = (d->instr == pop) ? 1 : 0; i<2; ++i)
+	{
+	  addLoc(cpu, locs, &n, WATCH_RAM, &atram(sp) - ram, WATCH_READ);
+	  --sp;
+	}
+      break;
+    }
+  for (i = 0; i<sizeof(sfrs)/sizeof(int); ++i) addLoc(cpu, locs, &n, WATCH_RAM, sfrs[i], 0);
+
+  exec(cpu, d);
+  if (!n) return;
+  updateParity();
+  for (i = 0; i<n; ++i)
+    {
+      value = locValue(cpu, locs + i);
+      if (locs[i].kind & WATCH_READ)
+	watchByte(&cpu->sim, locs[i].area, locs[i].index, WATCH_READ, locs[i].old, locs[i].old);
+      if ((locs[i].kind & WATCH_WRITE) || value != locs[i].old)
+	watchByte(&cpu->sim, locs[i].area, locs[i].index, WATCH_WRITE, locs[i].old, value);
+    }
+}
+
+#define execWatched(cpu, d) if ((cpu)->sim.watching) watchExec(cpu, d); else exec(cpu, d)
+
+/* step() executes the instruction at memory[pc]
+ */
+void step(sim_ctx *s)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  const decode_struct *d;
+
+  if (cpu->irq_next != UNDEF) /* taking an interrupt is a step */
+    {
+      vectorIrq(cpu, cpu->irq_next);
+      return;
+    }
+  d = getDecode(cpu, pc);
+  cpu->sim.cycles += cpu_instr_tkn[d->op][INSTR_TKN_CYCLES];
+  execWatched(cpu, d);
+}
+
+/* the timers are the peripherals of the 8051. An interrupt requested by
+ * an event, a timer or the code is taken by the next step(). PSW and the
+ * register bank are brought up to date here, as the cpu stops or starts
+ */
+void syncEvents(sim_ctx *s)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  event_struct e;
+
+  updateBank(cpu);
+  updateParity();
+  syncTimers(cpu, s->cycles);
+  if (cpu->tx_written) transmit(cpu);
+  while (dueEvent(s, &e))
+    {
+      if (e.kind == EVENT_IRQ && raiseIrq(cpu, e.value)) ++s->irq_gen;
+      if (e.kind == EVENT_SERIAL) serialEvent(cpu, e.value);
+    }
+  scheduleTimers(cpu);
+  scheduleRx(cpu);
+  cpu->irq_next = pendingIrq(cpu);
+  s->next_event = (cpu->irq_next == UNDEF) ? firstEvent(s) : s->cycles;
+}
+
+/* locations in an undo_rec are an index of ram or UNDO_XRAM plus an
+ * address of xram
+ */
+#define UNDO_XRAM (BYTE_MAX+BYTE_MAX/2)
+
+static void logRam(undo_rec *r, cpu_ctx *cpu, const int *p)
+{
+  r->where[r->num] = p - ram;
+  r->old[r->num++] = *p;
+}
+
+/* An instruction only changes its parameters, the registers acc, b,
+ * psw, sp and dptr, two bytes pushed on the stack or a byte of xram
+ * written by movx. The timers count on until the next syncEvents().
+ * All of them are saved before step() is called
+ */
+void logStep(sim_ctx *s, undo_rec *r)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  const decode_struct *d = getDecode(cpu, pc);
+  static const int sfrs[] = 
+    { ACC, B, PSW, SP, DPL, DPH, TCON, TL0, TH0, TL1, TH1, T2CON, TL2, TH2 };
+  int *p, i, bit, addr = d->addr, sp = ram[SP];
+
+  r->pc_addr = pc;
+  r->cycles = s->cycles;
+  r->regs[0] = stackBase;
+  r->regs[1] = cpu->in_service;
+  r->num = 0;
+  updateBank(cpu);
+  for (i = 0; i<2; ++i)
+    {
+      p = getParam(cpu, d->param + i, &bit, &addr);
+      if (p>=ram && p<ram + UNDO_XRAM) logRam(r, cpu, p);
+    }
+  if (d->instr == movx && !getParam(cpu, d->param, &bit, &addr))
+    {
+      r->where[r->num] = UNDO_XRAM + addr;
+      r->old[r->num++] = xram[addr];
+    }
+  for (i = 0; i<sizeof(sfrs)/sizeof(int); ++i) logRam(r, cpu, ram + sfrs[i]);
+  for (i = 0; i<2; ++i)
+    {
+      if (++sp == BYTE_MAX-1) sp = 0; /* as pushStack() */
+      logRam(r, cpu, &atram(sp));
+    }
+  step(s);
+}
+
+void undoStep(sim_ctx *s, const undo_rec *r)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  int i;
+
+  for (i = r->num - 1; i>=0; --i)
+    {
+      if (r->where[i]<UNDO_XRAM)
+	ram[r->where[i]] = r->old[i];
+      else
+	xram[r->where[i] - UNDO_XRAM] = r->old[i];
+    }
+  stackBase = r->regs[0];
+  cpu->in_service = r->regs[1];
+  pc = r->pc_addr;
+  s->cycles = cpu->timer_sync = r->cycles;
+  updateBank(cpu);
+  syncEvents(s);
+}
+
+/* sjmp, ajmp or ljmp to its own address
+ */
+int isHalt(sim_ctx *s, int addr)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  int op;
+
+  if (addr<0 || addr + 2>MEMORY_MAX) return FALSE;
+  op = memory[addr];
+  if (op == 0x80) return memory[addr + 1] == 0xFE;
+  if ((op & 0x1F) == 0x01)
+    return (((addr + 2) & 0xF800) | (op & 0xE0)*8 | memory[addr + 1]) == addr;
+  if (op == 0x02 && addr + 3<=MEMORY_MAX)
+    return memory[addr + 1]*BYTE_MAX + memory[addr + 2] == addr;
+  return FALSE;
+}
+
+/* return the kind of loop of block b or 0. A delay loop is djnz on a
+ * register or ram to its own address. A poll loop reads bits, ram,
+ * SFRs other than the timer counts or xram, moves them or masks them
+ * in acc and branches back on a condition. It only writes what it has
+ * read before, so once round it leaves everything as it was.
+ */
+static int loopKind(cpu_ctx *cpu, const block_struct *b)
+{
+  const decode_struct *d = b->code, *last = d + b->num - 1;
+  int i, j, target = b->end;
+
+  if (b->num == 1 && isHalt(&cpu->sim, b->start)) return LOOP_POLL;
+  relJmp(target, last->addr);
+  switch (last->instr)
+    {
+    case djnz:
+      if (target != b->start || b->num>1) return 0;
+      if (last->param[0].kind == reg_param || last->param[0].p<ram + 0x80) return LOOP_DELAY;
+      return 0;
+      break;
+    case cjne: case jb: case jnb: case jc: case jnc: case jz: case jnz:
+      if (target != b->start || b->num>LOOP_MAX) return 0;
+      break;
+    default:
+      return 0;
+      break;
+    }
+  for (i = 0; i<b->num; ++i)
+    {
+      if (d[i].flags & (psw_used + sp_used + irq_used + serial_used)) return 0;
+      for (j = 0; j<2; ++j)
+	if (isTimerSfr(cpu, d[i].param[j].p) && ((paramKind(d + i, j) & WATCH_WRITE) ||
+	    (d[i].param[j].p != ram + TCON && d[i].param[j].p != ram + T2CON)))
+	  return 0; /* flags are set by events, counts change all the time */
+      if (d + i == last) break;
+      switch (d[i].instr)
+	{
+	case mov:
+	  if (d[i].op == 0x90) return 0; /* mov dptr, #data16 */
+	  break;
+	case movx:
+	  if (d[i].param[0].p != ram + ACC) return 0;
+	  break;
+	case anl: case orl: case xrl:
+	  if (d[i].param[0].p != ram + ACC) return 0;
+	  break;
+	default:
+	  return 0;
+	  break;
+	}
+    }
+  return LOOP_POLL;
+}
+
+/* decode the instructions of block b for execBlock()
+ */
+void buildBlock(sim_ctx *s, block_struct *b)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  decode_struct *d = b->code;
+  int i, addr = b->start;
+
+  safeRealloc(d, decode_struct, b->num);
+  for (i = 0; i<b->num; ++i)
+    {
+      decode(cpu, addr, d + i);
+      addr += d[i].bytes;
+    }
+  for (i = b->num - 1, addr = 0; i>=0; --i)
+    {
+      d[i].left = addr;
+      addr += cpu_instr_tkn[d[i].op][INSTR_TKN_CYCLES];
+    }
+  b->code = d;
+  b->loop = loopKind(cpu, b);
+}
+
+/* execute the instructions of block b. 8051 code can't write to code
+ * memory, so a block always runs to its end (or an error), unless a
+ * watch is hit or an instruction lets an interrupt be taken
+ */
+int execBlock(sim_ctx *s, block_struct *b)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  const decode_struct *d = b->code, *end = d + b->num;
+  int n;
+
+  cpu->sim.cycles += b->cycles;
+  if (!cpu->sim.watching)
+    while (d<end)
+      {
+	exec(cpu, d);
+	if ((d++)->flags & irq_used) break;
+      }
+  else
+    while (d<end && !cpu->sim.watch_hit)
+      {
+	watchExec(cpu, d);
+	if ((d++)->flags & irq_used) break;
+      }
+  n = d - (const decode_struct*) b->code;
+  while (d<end) cpu->sim.cycles -= cpu_instr_tkn[(d++)->op][INSTR_TKN_CYCLES]; /* not executed */
+  return n;
+}
+
+/* the locations written by a poll loop are compared after it has been
+ * round once. Acc and PSW are written without being a parameter.
+ */
+int skipLoop(sim_ctx *s, block_struct *b, int count, unsigned long long limit)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  const decode_struct *d = b->code;
+  int *p[2 + 2*LOOP_MAX], old[2 + 2*LOOP_MAX], i, j, n = 0, bit, addr, done, times, *dst;
+  unsigned long long c = s->cycles;
+
+  p[n++] = ram + ACC;
+  p[n++] = ram + PSW;
+  if (b->loop == LOOP_POLL)
+    for (i = 0; i<b->num; ++i)
+      for (j = 0; j<2; ++j)
+	if ((paramKind(d + i, j) & WATCH_WRITE) && (p[n] = getParam(cpu, d[i].param + j, &bit, &addr)))
+	  ++n;
+  for (i = 0; i<n; ++i) old[i] = *p[i];
+  if ((done = execBlock(s, b))<b->num || pc != b->start) return done;
+  for (i = 0; i<n; ++i) if (*p[i] != old[i]) return done;
+
+  c = s->cycles - c;
+  times = loopTimes(s, b, c, count - done, limit);
+  if (b->loop == LOOP_DELAY) /* it has gone round once, *dst is not 0 */
+    {
+      dst = getParam(cpu, d->param, &bit, &addr);
+      if (times>*dst - 1) times = *dst - 1;
+      *dst -= times;
+    }
+  s->cycles += times*c;
+  return done + times*b->num;
 }
 
 /* getRegister will return the address to the name of the register given it
  * if *bit not UNDEF, register is one bit in length
  */
-int *getRegister(str_storage name, int *bit, int* bytes)
+int *getRegister(sim_ctx *s, str_storage name, int *bit, int* bytes)
 {
+  cpu_ctx *cpu = (cpu_ctx*) s;
   int index, addr;
   const str_storage *ret = bsearch(name, tokens, tokens_length, sizeof(str_storage), &cmpstr);
   if (!ret)
@@ -463,7 +1642,10 @@ int *getRegister(str_storage name, int *bit, int* bytes)
       index = ret - tokens + PROC_TOKEN;
       switch (index)
 	{
-	case dptr: return ram + DPL + BYTE_MAX*ram[DPH]; break;
+	case dptr:
+	  cpu->dptr_value = ram[DPL] + BYTE_MAX*ram[DPH];
+	  return &cpu->dptr_value;
+	  break;
 	case pc_reg: return &pc;   break;
 	case r0: case r1: case r2: case r3:
 	case r4: case r5: case r6: case r7: 
@@ -478,42 +1660,91 @@ int *getRegister(str_storage name, int *bit, int* bytes)
 /* getMemory will return the value of the memory location addr
  * m allows to access to internal RAM, external RAM and external ROM
  */
-int *getMemory(int addr, char m)
+int getMemory(sim_ctx *s, int addr, char m)
 {
+  cpu_ctx *cpu = (cpu_ctx*) s;
   int b, *mptr = NULL;
+  if (addr<0) return UNDEF;
   if (m == '\0') m = 'i';
   switch (m)
     {
     case 'd': 
-      if (addr>=BYTE_MAX) return NULL;
+      if (addr>=BYTE_MAX) return UNDEF;
       mptr = ram + addr;
       break;
     case 'i': 
-      if (addr>=BYTE_MAX) return NULL;
+      if (addr>=BYTE_MAX) return UNDEF;
       mptr = &atram(addr);
       break;
     case 'x':
-      if (addr>=MEMORY_MAX) return NULL;
-      mptr = xram + addr;
+      return (addr<MEMORY_MAX) ? xram[addr] : UNDEF;
       break;
     case 'c':
-      if (addr>=MEMORY_MAX) return NULL;
-      mptr = memory + addr;
+      return (addr<MEMORY_MAX) ? memory[addr] : UNDEF;
       break;
     case 'b':
+      if (addr>=BYTE_MAX) return UNDEF;
       bitAddr(addr, mptr, b);
       break;
     default:
       break;
     }
-  return mptr;
+  return (mptr) ? *mptr : UNDEF;
+}
+
+/* setMemory will store value at memory location addr. Code memory
+ * can only be written this way, so decoded instructions are dropped
+ */
+int setMemory(sim_ctx *s, int addr, char m, int value)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  int *mptr = NULL;
+  if (getMemory(s, addr, m) == UNDEF) return FALSE;
+  if (m == '\0') m = 'i';
+  switch (m)
+    {
+    case 'd': mptr = ram + addr;     break;
+    case 'i': mptr = &atram(addr);   break;
+    case 'b': mptr = bitByte(addr);   break;
+    case 'x': xram[addr] = value;    break;
+    case 'c':
+      invalidateDecode(cpu, addr);
+      codeWrite(s, addr);
+      memory[addr] = value;
+      break;
+    }
+  if (mptr) *mptr = value;
+  return TRUE;
+}
+
+/* ram is watched by its index, which is where atram() or a bit address
+ * is found
+ */
+int watchArea(sim_ctx *s, int addr, char m, int *index, int *bit)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  int *mptr = NULL;
+
+  if (getMemory(s, addr, m) == UNDEF) return UNDEF;
+  *bit = BYTE_MASK;
+  switch (m)
+    {
+    case 'x': *index = addr; return WATCH_XRAM;
+    case 'c': *index = addr; return WATCH_MEM;
+    case 'd': mptr = ram + addr;        break;
+    case 'b': bitAddr(addr, mptr, *bit); break;
+    default:  mptr = &atram(addr);      break;
+    }
+  *index = mptr - ram;
+  return WATCH_RAM;
 }
 
 /* Dump all the memory in hex text format to file. 
  * Should be able to restart simulator with this file
  */
-void dumpMemory(FILE* fd)
+void dumpMemory(sim_ctx *s, FILE* fd)
 {
+  cpu_ctx *cpu = (cpu_ctx*) s;
   int i;
 
   fprintf(fd, "PC: %04X\n", pc);
@@ -561,8 +1792,9 @@ void dumpMemory(FILE* fd)
 
 /* Load the file into memory produced by dumpMemory
  */
-void restoreMemory(FILE* fd)
+void restoreMemory(sim_ctx *s, FILE* fd)
 {
+  cpu_ctx *cpu = (cpu_ctx*) s;
   int i, addr;
 
   fscanf(fd, "PC: %04X\n", (unsigned int*) &pc);
@@ -599,18 +1831,141 @@ void restoreMemory(FILE* fd)
   for (i=0; i<65536; i+=16)
     {
        fscanf(fd, "%*[a-fA-F0-9] "
-	      "%02X %02X %02X %02X %02X %02X %02X %02X "
-	      "%02X %02X %02X %02X %02X %02X %02X %02X\n", 
-	      (unsigned int*) xram + i, (unsigned int*) xram + i + 1, (unsigned int*) xram + i + 2, (unsigned int*) xram + i + 3, 
-	      (unsigned int*) xram + i + 4, (unsigned int*) xram + i + 5, (unsigned int*) xram + i + 6, (unsigned int*) xram + i + 7,
-	      (unsigned int*) xram + i + 8, (unsigned int*) xram + i + 9, (unsigned int*) xram + i + 10, (unsigned int*) xram + i + 11,
-	      (unsigned int*) xram + i + 12, (unsigned int*) xram + i + 13, (unsigned int*) xram + i + 14, (unsigned int*) xram + i + 15);
+	      "%02hhX %02hhX %02hhX %02hhX %02hhX %02hhX %02hhX %02hhX "
+	      "%02hhX %02hhX %02hhX %02hhX %02hhX %02hhX %02hhX %02hhX\n", 
+	      xram + i, xram + i + 1, xram + i + 2, xram + i + 3, 
+	      xram + i + 4, xram + i + 5, xram + i + 6, xram + i + 7,
+	      xram + i + 8, xram + i + 9, xram + i + 10, xram + i + 11,
+	      xram + i + 12, xram + i + 13, xram + i + 14, xram + i + 15);
    }
 
   /* update data register back address form new PSW
    */
   addr = ram[PSW] & (rs1 + rs0);
   for (i = 0; i<8; ++i) reg[i] = ram + i + addr;
+  ++reg_gen;
+  cpu->timer_sync = cpu->sim.cycles;
+}
+
+/* snapshot of an 8051 is its internal ram and registers followed by
+ * xram and, if flag SNAP_CODE is set, code memory
+ */
+typedef struct
+{
+  snap_header head;
+  uint8_t iram[BYTE_MAX+BYTE_MAX/2];
+  uint8_t stack_base, in_service, pad[2];
+} snap_8051;
+
+int saveSnap(sim_ctx *s, int fd, int code)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  snap_8051 snap;
+  struct iovec iov[3];
+  int i;
+
+  initSnap(&snap.head, s, "8051", sizeof(snap), code ? SNAP_CODE : 0);
+  for (i = 0; i<BYTE_MAX+BYTE_MAX/2; ++i) snap.iram[i] = ram[i];
+  snap.stack_base = stackBase;
+  snap.in_service = cpu->in_service;
+  memset(snap.pad, 0, sizeof(snap.pad));
+  iov[0].iov_base = &snap;
+  iov[0].iov_len = sizeof(snap);
+  iov[1].iov_base = xram;
+  iov[1].iov_len = MEMORY_MAX;
+  iov[2].iov_base = memory;
+  iov[2].iov_len = MEMORY_MAX;
+  return writeSnap(fd, iov, code ? 3 : 2);
+}
+
+/* map the 8051 snapshot in fd, see mapSnap()
+ */
+static snap_8051 *getSnap(int fd, size_t *len, int write)
+{
+  snap_8051 *snap = (snap_8051*) mapSnap(fd, "8051", len, write);
+  int code;
+
+  if (!snap) return NULL;
+  code = (snap->head.flags & SNAP_CODE) != 0;
+  if (snap->head.size != sizeof(snap_8051) || 
+      *len != sizeof(snap_8051) + (1 + code)*MEMORY_MAX)
+    {
+      unmapSnap(snap, *len);
+      return NULL;
+    }
+  return snap;
+}
+
+/* set internal ram and registers of cpu from snapshot
+ */
+static void setSnap(cpu_ctx *cpu, const snap_8051 *snap)
+{
+  int i, addr;
+
+  for (i = 0; i<BYTE_MAX+BYTE_MAX/2; ++i) ram[i] = snap->iram[i];
+  stackBase = snap->stack_base;
+  cpu->in_service = snap->in_service;
+  cpu->irq_next = UNDEF;
+  pc = snap->head.pc_addr;
+  cpu->sim.cycles = cpu->timer_sync = snap->head.cycles;
+
+  addr = ram[PSW] & (rs1 + rs0);
+  for (i = 0; i<8; ++i) reg[i] = ram + i + addr;
+  ++reg_gen;
+}
+
+/* code memory is only replaced if it is in the snapshot. A text dump
+ * converted with sim --core does not have it
+ */
+int loadSnap(sim_ctx *s, int fd)
+{
+  cpu_ctx *cpu = (cpu_ctx*) s;
+  const snap_8051 *snap;
+  const uint8_t *region;
+  size_t len;
+  int page;
+
+  if (!(snap = getSnap(fd, &len, FALSE))) return FALSE;
+  setSnap(cpu, snap);
+  region = (const uint8_t*) (snap + 1);
+  memcpy(xram, region, MEMORY_MAX);
+  if (snap->head.flags & SNAP_CODE)
+    {
+      memcpy(memory, region + MEMORY_MAX, MEMORY_MAX);
+      for (page = 0; page<MEMORY_MAX/DECODE_PAGE; ++page)
+	{
+	  free(decode_table[page]);
+	  decode_table[page] = NULL;
+	}
+      flushBlocks(s);
+    }
+  unmapSnap(snap, len);
+  return TRUE;
+}
+
+/* xram and code memory of the new 8051 are in the mapping
+ */
+sim_ctx *mapSim(int fd)
+{
+  cpu_ctx *cpu;
+  snap_8051 *snap;
+  uint8_t *region;
+  size_t len;
+
+  if (!(snap = getSnap(fd, &len, TRUE))) return NULL;
+  if (!(snap->head.flags & SNAP_CODE))
+    {
+      unmapSnap(snap, len);
+      return NULL;
+    }
+  region = (uint8_t*) (snap + 1);
+  cpu = (cpu_ctx*) newSim(region + MEMORY_MAX);
+  free(xram);
+  xram = region;
+  cpu->sim.snap = snap;
+  cpu->sim.snap_len = len;
+  setSnap(cpu, snap);
+  return &cpu->sim;
 }
 
 /***************************************
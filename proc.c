@@ -38,7 +38,7 @@
 
 /* Store a 16 bit word depedent on the endian of the processor
  */
-void storeWord(int *addr, int value)
+void storeWord(uint8_t *addr, int value)
 {
 #if CPU_BIG_ENDIAN
   *addr = getHigh(value); ++addr;
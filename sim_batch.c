@@ -0,0 +1,404 @@
+/*************************************************************************************
+
+    Copyright (c) 2003 - 2005 by James L. Terman
+    This file is part of the Simulator
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ *************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <setjmp.h>
+#include <limits.h>
+#include <assert.h>
+#include <pthread.h>
+
+#define BATCH_LOCAL
+
+#include "asmdefs.h"
+#include "asm.h"
+#include "cpu.h"
+#include "err.h"
+#include "block.h"
+#include "snap.h"
+#include "cover.h"
+#include "batch.h"
+
+/* a setting of a run from the manifest: register @name=value, memory
+ * $addr[:c]=value,value,... or stop=addr
+ */
+typedef struct
+{
+  char kind;   /* '@', '$' or 's' for a stop address */
+  char m;      /* memory area, as for getMemory()    */
+  char *name;  /* name of register                   */
+  int addr;    /* address of memory or stop          */
+  int num;     /* number of values                   */
+  int *values; /* value of register or memory bytes  */
+} batch_set;
+
+typedef struct
+{
+  char *name;               /* first word of manifest line             */
+  int count;                /* max number of instructions executed     */
+  unsigned long long limit; /* max cycles executed                     */
+  int num_sets;             /* number of settings                      */
+  batch_set *sets;          /* settings applied after powerOn()        */
+  char *result;             /* final state of run, see saveResult()    */
+} batch_run;
+
+/* runs not yet started by a thread. It takes them from next, the
+ * other threads steal from end when they have run out of their own
+ */
+typedef struct
+{
+  pthread_mutex_t lock;
+  int next;
+  int end;
+} batch_queue;
+
+static batch_run *runs = NULL;
+static int num_runs = 0;
+static int size_runs = 0;
+
+static batch_queue *queues = NULL;  /* one for each thread              */
+static int num_queues = 0;
+static const uint8_t *image = NULL; /* code memory every run starts with */
+static const sim_state *state = NULL; /* or the state it is forked from  */
+static sim_ctx *check = NULL;       /* machine to check settings with    */
+static cover_map *cover = NULL;     /* code executed by all runs or NULL */
+static pthread_mutex_t cover_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* get values v1,v2,... of setting set
+ */
+static void getValues(batch_set *set, char *list)
+{
+  int size = 0;
+  char *comma;
+
+  do
+    {
+      if ((comma = strchr(list, ','))) *comma = '\0';
+      if (!*list) longjmp(err, miss_param);
+      safeAddArray(int, set->values, set->num, size);
+      set->values[set->num++] = getExpr(list);
+      list = comma + 1;
+    }
+  while (comma);
+}
+
+/* the settings of line are checked with the registers and memory of
+ * machine check, before any run is started
+ */
+void addBatchRun(char *line, int count)
+{
+  batch_run *r;
+  batch_set *set;
+  char *word, *value;
+  int i, bit, bytes, len, size_sets = 0;
+
+  if (!check)
+    {
+      check = newSim(NULL);
+      powerOn(check);
+    }
+  safeAddArray(batch_run, runs, num_runs, size_runs);
+  r = runs + num_runs;
+  memset(r, 0, sizeof(batch_run));
+  r->count = count;
+  r->limit = ULLONG_MAX;
+
+  for (i = 0; line[i] && !isspace(line[i]); ++i);
+  for (; line[i]; ++i) line[i] = tolower(line[i]);
+  word = strtok(line, "\040\t");
+  safeDupStr(r->name, word);
+  while ((word = strtok(NULL, "\040\t")))
+    {
+      if (!(value = strchr(word, '='))) longjmp(err, bad_param);
+      *value++ = '\0';
+      if (!strcmp(word, "count"))
+	{
+	  if ((r->count = getExpr(value))<0) longjmp(err, out_range);
+	  continue;
+	}
+      if (!strcmp(word, "cycles"))
+	{
+	  r->limit = getExpr(value);
+	  continue;
+	}
+
+      safeAddArray(batch_set, r->sets, r->num_sets, size_sets);
+      set = r->sets + r->num_sets++;
+      memset(set, 0, sizeof(batch_set));
+      set->kind = word[0];
+      switch (set->kind)
+	{
+	case '@':
+	  if (!getRegister(check, word + 1, &bit, &bytes)) longjmp(err, no_reg);
+	  safeDupStr(set->name, word + 1);
+	  getValues(set, value);
+	  if (set->num != 1) longjmp(err, extra_param);
+	  if (bit == UNDEF) set->values[0] &= (1 << 8*bytes) - 1;
+	  break;
+	case '$':
+	  len = strlen(word);
+	  if (len>3 && word[len - 2] == ':')
+	    {
+	      set->m = word[len - 1];
+	      word[len - 2] = '\0';
+	    }
+	  set->addr = getExpr(word + 1);
+	  getValues(set, value);
+	  for (i = 0; i<set->num; ++i)
+	    {
+	      if (getMemory(check, set->addr + i, set->m) == UNDEF) longjmp(err, out_range);
+	    }
+	  break;
+	default:
+	  if (strcmp(word, "stop")) longjmp(err, bad_param);
+	  set->kind = 's';
+	  set->addr = getExpr(value);
+	  if (set->addr<0 || set->addr>=MEMORY_MAX) longjmp(err, out_range);
+	  break;
+	}
+    }
+  ++num_runs;
+}
+
+/* return the next run for thread self or UNDEF, if all have been taken.
+ * If its own queue is empty, the upper half of another is stolen
+ */
+static int takeRun(int self)
+{
+  batch_queue *q = queues + self, *v;
+  int i, run = UNDEF, end = 0;
+
+  pthread_mutex_lock(&q->lock);
+  if (q->next<q->end) run = q->next++;
+  pthread_mutex_unlock(&q->lock);
+
+  for (i = 1; run == UNDEF && i<num_queues; ++i)
+    {
+      v = queues + (self + i)%num_queues;
+      pthread_mutex_lock(&v->lock);
+      if (v->next<v->end)
+	{
+	  end = v->end;
+	  run = v->end = v->next + (v->end - v->next)/2;
+	}
+      pthread_mutex_unlock(&v->lock);
+    }
+  if (run != UNDEF && end)
+    {
+      pthread_mutex_lock(&q->lock);
+      q->next = run + 1;
+      q->end = end;
+      pthread_mutex_unlock(&q->lock);
+    }
+  return run;
+}
+
+/* make code memory of s the same as image. Only bytes that differ are
+ * written, blocks of code the last run has not changed are kept
+ */
+static void loadImage(sim_ctx *s)
+{
+  int page, addr;
+
+  for (page = 0; page<MEMORY_MAX; page += BLOCK_PAGE)
+    {
+      if (!memcmp(s->memory + page, image + page, BLOCK_PAGE)) continue;
+      for (addr = page; addr<page + BLOCK_PAGE; ++addr)
+	{
+	  if (s->memory[addr] != image[addr]) setMemory(s, addr, 'c', image[addr]);
+	}
+    }
+}
+
+/* apply the settings of run r to s, stop addresses are set as breaks
+ * if flag is TRUE and cleared otherwise
+ */
+static void setRun(sim_ctx *s, const batch_run *r, int flag)
+{
+  const batch_set *set;
+  int i, bit, bytes, *reg;
+
+  for (set = r->sets; set<r->sets + r->num_sets; ++set)
+    {
+      switch (set->kind)
+	{
+	case '@':
+	  if (!flag) break;
+	  reg = getRegister(s, set->name, &bit, &bytes);
+	  if (bit == UNDEF)
+	    *reg = set->values[0];
+	  else
+	    setBit(set->values[0], reg, bit);
+	  break;
+	case '$':
+	  if (!flag) break;
+	  for (i = 0; i<set->num; ++i) setMemory(s, set->addr + i, set->m, set->values[i]);
+	  break;
+	default:
+	  if (flag)
+	    s->brk_map[set->addr/BRK_BITS] |= brkBit(set->addr);
+	  else
+	    s->brk_map[set->addr/BRK_BITS] &= ~brkBit(set->addr);
+	  codeWrite(s, set->addr);
+	  break;
+	}
+    }
+}
+
+/* FNV-1a hash of all memory of s
+ */
+static unsigned int memorySum(sim_ctx *s)
+{
+  static const char areas[] = "cdix";
+  unsigned int sum = 2166136261u;
+  const char *m;
+  int addr, value;
+
+  for (m = areas; *m; ++m)
+    {
+      for (addr = 0; (value = getMemory(s, addr, *m)) != UNDEF; ++addr) sum = (sum ^ value)*16777619u;
+    }
+  return sum;
+}
+
+/* result of run r is its name, how it ended, cycles, registers as
+ * printed by the 'pr' command and a hash of memory
+ */
+static void saveResult(sim_ctx *s, batch_run *r, const char *status)
+{
+  int t, n, bit, bytes, *reg;
+
+  safeMalloc(r->result, char, strlen(r->name) + 4*BUFFER_SIZE);
+  n = sprintf(r->result, "%s %s cycles: %llu", r->name, status, s->cycles);
+  for (t = 0; t<tokens_length; ++t)
+    {
+      if (!(reg = getRegister(s, tokens[t], &bit, &bytes))) continue;
+      if (bit == UNDEF)
+	n += sprintf(r->result + n, " %s: %0*X", tokens[t], 2*bytes, *reg);
+      else
+	n += sprintf(r->result + n, " %s: %d", tokens[t], (*reg&bit)>0);
+    }
+  sprintf(r->result + n, " sum: %08X", memorySum(s));
+}
+
+/* execute run r on s until count instructions, cycles or a stop address.
+ */
+static void doRun(sim_ctx *s, batch_run *r)
+{
+  char status[BUFFER_SIZE];
+  int errNo;
+
+  if (!state)
+    {
+      loadImage(s);
+      powerOn(s);
+    }
+  setRun(s, r, TRUE);
+  if ((errNo = setjmp(*s->err)) != 0)
+    {
+      sprintf(status, "error #%d", errNo);
+    }
+  else
+    {
+      runBlocks(s, r->count, r->limit);
+      strcpy(status, isBrk(s, s->pc) ? "stop" : (s->cycles>=r->limit) ? "cycles" : "count");
+    }
+  setRun(s, r, FALSE);
+  saveResult(s, r, status);
+}
+
+/* every thread has its own machine and reports its errors to run_err.
+ * Runs from a state fork a new machine each. The code executed by the
+ * thread is recorded in its own map and merged into cover at the end
+ */
+static void *worker(void *q)
+{
+  int self = (batch_queue*) q - queues, run;
+  jmp_buf run_err;
+  sim_ctx *s = (state) ? NULL : newSim(NULL);
+  cover_map *map = NULL;
+
+  if (cover) safeCalloc(map, cover_map, 1);
+  while ((run = takeRun(self)) != UNDEF)
+    {
+      if (state && !(s = forkState(state)))
+	{
+	  fprintf(stderr, "Can't map state of machine!\n"); exit(1);
+	}
+      s->err = &run_err;
+      if (map) setCover(s, map);
+      doRun(s, runs + run);
+      if (state) freeSim(s);
+    }
+  if (!state) freeSim(s);
+  if (map)
+    {
+      pthread_mutex_lock(&cover_lock);
+      mergeCover(cover, map);
+      pthread_mutex_unlock(&cover_lock);
+      free(map);
+    }
+  return NULL;
+}
+
+/* the runs are divided evenly among the threads at the start
+ */
+void runBatch(int threads, const uint8_t *code, const sim_state *from, cover_map *map)
+{
+  pthread_t *tids = NULL;
+  int i;
+
+  if (check) freeSim(check);
+  check = NULL;
+  if (threads>num_runs) threads = num_runs;
+  if (threads<1) return;
+
+  image = code;
+  state = from;
+  cover = map;
+  num_queues = threads;
+  safeCalloc(queues, batch_queue, threads);
+  safeCalloc(tids, pthread_t, threads);
+  for (i = 0; i<threads; ++i)
+    {
+      pthread_mutex_init(&queues[i].lock, NULL);
+      queues[i].next = (long long) i*num_runs/threads;
+      queues[i].end = (long long) (i + 1)*num_runs/threads;
+    }
+  for (i = 0; i<threads; ++i)
+    {
+      if (pthread_create(tids + i, NULL, &worker, queues + i))
+	{
+	  fprintf(stderr, "Can't start thread!\n"); exit(1);
+	}
+    }
+  for (i = 0; i<threads; ++i) pthread_join(tids[i], NULL);
+  for (i = 0; i<threads; ++i) pthread_mutex_destroy(&queues[i].lock);
+  free(tids);
+}
+
+void printBatch(FILE *fd)
+{
+  int i;
+
+  for (i = 0; i<num_runs; ++i) fprintf(fd, "%s\n", runs[i].result);
+}
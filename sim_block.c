@@ -0,0 +1,238 @@
+/*************************************************************************************
+
+    Copyright (c) 2003 - 2005 by James L. Terman
+    This file is part of the Simulator
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ *************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <limits.h>
+
+#define BLOCK_LOCAL
+
+#include "asmdefs.h"
+#include "asm.h"
+#include "cpu.h"
+#include "err.h"
+#include "sim.h"
+#include "block.h"
+#include "ctx.h"
+#include "snap.h"
+#include "cover.h"
+
+#define isValid(s, b) ((b)->gen[0] == (s)->code_gen[(b)->page[0]] && \
+		       (b)->gen[1] == (s)->code_gen[(b)->page[1]])
+
+/* set up the common part of ctx s to run on mem or its own memory
+ */
+void initCtx(sim_ctx *s, uint8_t *mem)
+{
+  s->own_memory = !mem;
+  if (!mem) safeCalloc(mem, uint8_t, MEMORY_MAX);
+  s->memory = mem;
+  s->err = &err;
+  s->next_event = ULLONG_MAX;
+}
+
+/* free the blocks and the memory of ctx s
+ */
+void freeCtx(sim_ctx *s)
+{
+  int page, i;
+  block_struct *b;
+
+  for (page = 0; page<MEMORY_MAX/BLOCK_PAGE; ++page)
+    {
+      if (!s->block_table[page]) continue;
+      for (i = 0; i<BLOCK_PAGE; ++i)
+	{
+	  if (!(b = s->block_table[page][i])) continue;
+	  free(b->code);
+	  free(b);
+	}
+      free(s->block_table[page]);
+    }
+  free(s->events);
+  if (s->own_memory) free(s->memory);
+  if (s->snap) unmapSnap(s->snap, s->snap_len);
+}
+
+/* code at addr has been changed. Any block with code in the same page
+ * is not valid anymore
+ */
+void invalidateCode(sim_ctx *s, int addr)
+{
+  int page = addr/BLOCK_PAGE;
+
+  ++s->code_gen[page];
+  memset(s->code_map + page*BLOCK_PAGE, FALSE, BLOCK_PAGE);
+  s->code_written = TRUE;
+}
+
+/* invalidate all blocks
+ */
+void flushBlocks(sim_ctx *s)
+{
+  int page;
+
+  for (page = 0; page<MEMORY_MAX/BLOCK_PAGE; ++page) ++s->code_gen[page];
+  memset(s->code_map, FALSE, MEMORY_MAX);
+  s->code_written = TRUE;
+}
+
+/* return valid block at addr. (Re)build it, if not found or invalid.
+ * The block table is allocated a page at a time
+ */
+static block_struct *getBlock(sim_ctx *s, int addr)
+{
+  block_struct **page = s->block_table[addr/BLOCK_PAGE], *b;
+  int op, end = addr;
+
+  if (!page)
+    {
+      safeCalloc(page, block_struct*, BLOCK_PAGE);
+      s->block_table[addr/BLOCK_PAGE] = page;
+    }
+  b = page[addr%BLOCK_PAGE];
+  if (b && isValid(s, b)) return b;
+  if (!b)
+    {
+      safeCalloc(b, block_struct, 1);
+      page[addr%BLOCK_PAGE] = b;
+    }
+
+  /* block ends after a branch or before a break, an illegal byte or
+   * an instruction that runs past the end of memory
+   */
+  b->start = addr; b->num = b->cycles = 0;
+  while (b->num<BLOCK_MAX)
+    {
+      op = s->memory[end];
+      if (isBrk(s, end)) break;
+      if (end + cpu_instr_tkn[op][INSTR_TKN_BYTES]>MEMORY_MAX) break;
+      end += cpu_instr_tkn[op][INSTR_TKN_BYTES];
+      b->cycles += cpu_instr_tkn[op][INSTR_TKN_CYCLES];
+      ++b->num;
+      if (isBranch(op)) break;
+    }
+  b->end = end;
+  memset(s->code_map + addr, TRUE, end - addr);
+  b->page[0] = addr/BLOCK_PAGE;
+  b->page[1] = (end>addr) ? (end - 1)/BLOCK_PAGE : b->page[0];
+  b->gen[0] = s->code_gen[b->page[0]];
+  b->gen[1] = s->code_gen[b->page[1]];
+  b->next[0] = b->next[1] = NULL;
+  b->cover = b->loop = 0;
+  if (b->num) buildBlock(s, b);
+  return b;
+}
+
+/* record in the cover map of s that n instructions of block b have been
+ * executed. Once a block and the way it left are recorded, it is not
+ * looked at again until the map changes
+ */
+static void coverBlock(sim_ctx *s, block_struct *b, int n)
+{
+  int addr, last = b->start, i, flag;
+
+  if (b->cover_gen != s->cover_gen)
+    {
+      b->cover = 0;
+      b->cover_gen = s->cover_gen;
+    }
+  flag = (n<b->num) ? 0 : BLOCK_EXEC | ((s->pc == b->end) ? BLOCK_NEXT : BLOCK_TAKEN);
+  if (flag && (b->cover | flag) == b->cover) return;
+
+  for (addr = b->start, i = 0; i<n; ++i)
+    {
+      setCovered(s->cover->exec, addr);
+      last = addr;
+      addr += cpu_instr_tkn[s->memory[addr]][INSTR_TKN_BYTES];
+    }
+  if (!flag) return;
+  b->cover |= flag;
+  if (isCondBranch(s->memory[last]))
+    setCovered((flag & BLOCK_NEXT) ? s->cover->next : s->cover->taken, last);
+}
+
+int loopTimes(sim_ctx *s, const block_struct *b, int c, int count, unsigned long long limit)
+{
+  unsigned long long end = (limit<s->next_event) ? limit : s->next_event, n;
+
+  if (c<=0 || s->cycles + b->cycles>=end) return 0;
+  n = (end - 1 - s->cycles - b->cycles)/c + 1;
+  return (n<count/b->num) ? n : count/b->num;
+}
+
+/* runBlocks will execute blocks of ctx s starting at pc. The block following
+ * the last one is looked up in its next[] (1: fall through, 0: other)
+ * before the block table. A valid block can't contain a break, so pc
+ * only needs to be checked for a break when the block table is used.
+ * Blocks longer than what is left of count or whose table cycles would
+ * pass limit or the next event or that could not be built are executed
+ * with step(), so an event is seen after the instruction it is due in.
+ * A loop is run by skipLoop(), unless there are watches.
+ */
+int runBlocks(sim_ctx *s, int count, unsigned long long limit)
+{
+  block_struct *b, *last = NULL;
+  int n = 0, addr, done;
+
+  s->code_written = FALSE;
+  syncEvents(s);
+  while (count)
+    {
+      if (s->cycles>=s->next_event) syncEvents(s);
+      if (last) b = last->next[n = (s->pc == last->end)];
+      if (!last || !b || b->start != s->pc || !isValid(s, b))
+	{
+	  if (isBrk(s, s->pc)) break;
+	  b = getBlock(s, s->pc);
+	  if (last) last->next[n] = b;
+	}
+
+      if (!b->num || b->num>count || s->cycles + b->cycles>limit ||
+	  s->cycles + b->cycles>s->next_event)
+	{
+	  if (s->cycles>=limit) break;
+	  addr = s->pc;
+	  step(s);
+	  if (s->cover) coverStep(s, addr);
+	  --count;
+	  last = NULL;
+	  if (s->watch_hit) break;
+	  continue;
+	}
+      if (b->loop && !s->watching)
+	done = skipLoop(s, b, count, limit);
+      else
+	done = execBlock(s, b);
+      count -= done;
+      if (s->cover) coverBlock(s, b, (done<b->num) ? done : b->num);
+      if (s->watch_hit) break;
+      last = b;
+      if (s->code_written)
+	{
+	  last = NULL;
+	  s->code_written = FALSE;
+	}
+    }
+  syncEvents(s);
+  return count;
+}
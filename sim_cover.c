@@ -0,0 +1,110 @@
+/*************************************************************************************
+
+    Copyright (c) 2003 - 2005 by James L. Terman
+    This file is part of the Simulator
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ *************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#define COVER_LOCAL
+
+#include "asmdefs.h"
+#include "cpu.h"
+#include "ctx.h"
+#include "cover.h"
+
+/* a map file is COVER_MAGIC, the name of the cpu as in cpu_version and
+ * the bitmaps of the map
+ */
+typedef struct
+{
+  char magic[4];
+  char cpu[8];
+} cover_header;
+
+void coverStep(sim_ctx *s, int addr)
+{
+  int op = s->memory[addr];
+
+  setCovered(s->cover->exec, addr);
+  if (!isCondBranch(op)) return;
+  if (s->pc == addr + cpu_instr_tkn[op][INSTR_TKN_BYTES])
+    setCovered(s->cover->next, addr);
+  else
+    setCovered(s->cover->taken, addr);
+}
+
+/* the blocks of s check themselves again when the generation changes
+ */
+void setCover(sim_ctx *s, cover_map *map)
+{
+  s->cover = map;
+  ++s->cover_gen;
+}
+
+void mergeCover(cover_map *to, const cover_map *from)
+{
+  const uint8_t *f = (const uint8_t*) from;
+  uint8_t *t = (uint8_t*) to;
+  int i;
+
+  for (i = 0; i<sizeof(cover_map); ++i) t[i] |= f[i];
+}
+
+/* header of map files of this cpu
+ */
+static void initHeader(cover_header *head)
+{
+  int i;
+
+  memset(head, 0, sizeof(cover_header));
+  memcpy(head->magic, COVER_MAGIC, sizeof(head->magic));
+  for (i = 0; i<sizeof(head->cpu) && cpu_version[i] && cpu_version[i] != ' '; ++i) head->cpu[i] = cpu_version[i];
+}
+
+int saveCover(const cover_map *map, const char *file)
+{
+  cover_header head;
+  FILE *fd = fopen(file, "wb");
+  int ok;
+
+  if (!fd) return FALSE;
+  initHeader(&head);
+  ok = fwrite(&head, sizeof(head), 1, fd) == 1 && fwrite(map, sizeof(cover_map), 1, fd) == 1;
+  return (fclose(fd) == 0) && ok;
+}
+
+int loadCover(cover_map *map, const char *file)
+{
+  cover_header head, file_head;
+  cover_map *from = NULL;
+  FILE *fd = fopen(file, "rb");
+  int ok;
+
+  if (!fd) return FALSE;
+  initHeader(&head);
+  safeMalloc(from, cover_map, 1);
+  ok = fread(&file_head, sizeof(file_head), 1, fd) == 1 && !memcmp(&head, &file_head, sizeof(head)) &&
+    fread(from, sizeof(cover_map), 1, fd) == 1;
+  fclose(fd);
+  if (ok) mergeCover(map, from);
+  free(from);
+  return ok;
+}
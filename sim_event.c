@@ -0,0 +1,98 @@
+/*************************************************************************************
+
+    Copyright (c) 2003 - 2005 by James L. Terman
+    This file is part of the Simulator
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ *************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#define EVENT_LOCAL
+
+#include "asmdefs.h"
+#include "ctx.h"
+#include "event.h"
+
+/* the parent of event i in the heap is (i - 1)/2. Every event is due
+ * at or after its parent, so the first one is due first
+ */
+#define parent(i) (((i) - 1)/2)
+
+/* put e at the place of event i or further down the heap
+ */
+static void siftDown(sim_ctx *s, int i, event_struct e)
+{
+  event_struct *heap = s->events;
+  int child;
+
+  while ((child = 2*i + 1)<s->num_event)
+    {
+      if (child + 1<s->num_event && heap[child + 1].cycles<heap[child].cycles) ++child;
+      if (e.cycles<=heap[child].cycles) break;
+      heap[i] = heap[child];
+      i = child;
+    }
+  heap[i] = e;
+}
+
+void addEvent(sim_ctx *s, unsigned long long cycles, int kind, int value)
+{
+  event_struct *heap;
+  int i;
+
+  safeAddArray(event_struct, s->events, s->num_event, s->size_event);
+  heap = s->events;
+  for (i = s->num_event++; i && cycles<heap[parent(i)].cycles; i = parent(i))
+    heap[i] = heap[parent(i)];
+  heap[i].cycles = cycles;
+  heap[i].kind = kind;
+  heap[i].value = value;
+  if (cycles<s->next_event) s->next_event = cycles;
+}
+
+int dueEvent(sim_ctx *s, event_struct *e)
+{
+  if (!s->num_event || s->events[0].cycles>s->cycles) return FALSE;
+  *e = s->events[0];
+  if (--s->num_event) siftDown(s, 0, s->events[s->num_event]);
+  return TRUE;
+}
+
+/* the events left are put back into a heap from the bottom up
+ */
+void delEvents(sim_ctx *s, int kind)
+{
+  int i, n = 0;
+
+  for (i = 0; i<s->num_event; ++i) 
+    if (kind != UNDEF && s->events[i].kind != kind) s->events[n++] = s->events[i];
+  if (n == s->num_event) return;
+  s->num_event = n;
+  for (i = n/2 - 1; i>=0; --i) siftDown(s, i, s->events[i]);
+}
+
+unsigned long long firstEvent(sim_ctx *s)
+{
+  return (s->num_event) ? s->events[0].cycles : ULLONG_MAX;
+}
+
+const event_struct *getEvents(sim_ctx *s, int *num)
+{
+  *num = s->num_event;
+  return s->events;
+}
@@ -24,6 +24,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <setjmp.h>
+#include <limits.h>
 
 #ifdef __WIN32__
 #include <io.h>
@@ -36,26 +37,94 @@
 #include "cpu.h"
 #include "err.h"
 #include "sim.h"
+#include "block.h"
+#include "cover.h"
+
+#define EXEC_BUDGET 0x10000 /* max instructions per call to runBlocks() */
 
 static brk_struct* brk_table = NULL;
 static int num_brk = 1;
 static int size_brk = 0;
+static int free_brk = 0;     /* first free entry in brk_table, 0 if none */
+
+typedef struct
+{
+  char *str;       /* expression string       */
+  expr_code *code; /* its compiled expression */
+} sim_expr;
+
+static sim_expr *sim_exprs = NULL; /* expressions compiled by getSimExpr() */
+
+/* the undo log is a ring of the records of the last undo_size steps,
+ * undo_next is the one written next. It is off if undo_size is 0
+ */
+static undo_rec *undo_log = NULL;
+static int undo_size = 0;
+static int undo_next = 0;
+static int undo_num = 0;  /* number of records that can be undone */
+
+/* instructions executed and the cycles they took at each address while
+ * profiling. They are kept when it is turned off, until the next start
+ */
+static unsigned long long *prof_count = NULL;
+static unsigned long long *prof_cycles = NULL;
+static int profiling = FALSE;
+
+/* call graph of the profile. A frame of the shadow call stack is the
+ * node of a call and its return address. ret_count counts the frames
+ * with each return address, a step that ends at one has returned
+ */
+#define CALL_MAX 256 /* max depth of call graph */
+
+typedef struct
+{
+  int node;   /* node of calling subroutine */
+  int ret;    /* address call returns to    */
+} call_frame;
+
+static call_node *call_nodes = NULL;
+static int num_nodes = 0;
+static int size_nodes = 0;
+static int call_now = 0;  /* node of subroutine being executed */
+static call_frame call_stack[CALL_MAX];
+static int num_frames = 0;
+static int *ret_count = NULL;
+
+/* blocks are not logged or profiled, only single steps
+ */
+#define stepOnly() (undo_size || profiling)
+static int num_exprs = 0;
+static int size_exprs = 0;
+
+sim_ctx *sim = NULL;         /* machine of the debugger commands */
 
 int run_sim = FALSE;         /* true when simulator is running */
 
 /* global function called from assembler for memory reference
- * Evalues memory location expression $addr[:c]
+ * Evalues memory location expression $addr[:c]. Registers are returned
+ * by their address, memory by a copy of its byte (see setMemory()).
  */
 int *getMemExpr(char *expr, int *addr, char *c)
 {
+  static int cycles_expr; /* @cycles, cycle counter up to INT_MAX   */
+  static int mem_expr;    /* byte at $addr[:c]                     */
   int bit;
 
   if (!run_sim) return NULL;
 
   if (expr[0] == '@')
     {
-      if (!strcmp(expr + 1, "pc")) return &pc;
-      return getRegister(expr + 1, &bit, addr);
+      if (!strcmp(expr + 1, "pc")) return &sim->pc;
+      if (!strcmp(expr + 1, "cycles"))
+	{
+	  /* an int can't hold more, it stops at INT_MAX instead of wrapping
+	   */
+	  if (sim->cycles>INT_MAX && cycles_expr != INT_MAX)
+	    printf("Warning: @cycles has passed %d and stays at it\n", INT_MAX);
+	  cycles_expr = (sim->cycles>INT_MAX) ? INT_MAX : sim->cycles;
+	  return &cycles_expr;
+	}
+      return getRegister(sim, expr + 1, &bit, addr);
     }
   else  if (expr[0] == '$')
     ++expr;
@@ -67,34 +136,115 @@ int *getMemExpr(char *expr, int *addr, char *c)
       expr[strlen(expr) - 2] = '\0';
     }
   *addr = getExpr(expr);
-  return getMemory(*addr, *c);
+  mem_expr = getMemory(sim, *addr, *c);
+  return (mem_expr == UNDEF) ? NULL : &mem_expr;
+}
+
+/* display and print commands evaluate the same expressions over and
+ * over. Compile each once, only when it compiled without error is it kept
+ */
+int getSimExpr(char *expr)
+{
+  int i;
+  expr_code *code;
+
+  for (i = 0; i<num_exprs; ++i)
+    {
+      if (!strcmp(sim_exprs[i].str, expr)) return evalExpr(sim_exprs[i].code);
+    }
+  code = compileExpr(expr);
+  safeAddArray(sim_expr, sim_exprs, num_exprs, size_exprs);
+  sim_exprs[num_exprs].str = strdup(expr);
+  sim_exprs[num_exprs].code = code;
+  return evalExpr(sim_exprs[num_exprs++].code);
+}
+
+/* set the bit of a break at addr in brk_map
+ */
+static void armBrk(int addr)
+{
+  sim->brk_map[addr/BRK_BITS] |= brkBit(addr);
+  codeWrite(sim, addr); /* no block may run over a break */
+}
+
+/* return number of break at addr or UNDEF, if there is none
+ */
+static int findBrk(int addr)
+{
+  int brk;
+
+  if (!isBrk(sim, addr)) return UNDEF;
+  for (brk = 0; brk<num_brk; ++brk)
+    {
+      if (brk_table[brk].used && brk_table[brk].pc == addr) return brk;
+    }
+  return UNDEF;
+}
+
+/* allocate brk_table with the entry for the next command not used
+ */
+static void initBrks(void)
+{
+  if (brk_table) return;
+  safeAddArray(brk_struct, brk_table, num_brk, size_brk);
+  brk_table[0].used = FALSE;
+  brk_table[0].expr = NULL;
+  brk_table[0].code = NULL;
 }
 
 /* first break in array reserved for next command
  */
 void setNextBrk(int addr)
 {
-  safeAddArray(brk_struct, brk_table, num_brk, size_brk);
+  initBrks();
+  delBrk(0); /* left over, if last run was stopped by an error */
   brk_table[0].tmp = TRUE;
   brk_table[0].used = TRUE;
   brk_table[0].pc = addr;
-  brk_table[0].op = memory[addr];
   brk_table[0].expr = NULL;
+  brk_table[0].code = NULL;
+  armBrk(addr);
 }
 
-/* Add a break at the memory address given
+/* Add a break at the memory address given. Entries of deleted breaks
+ * are reused before the array is grown. expr is compiled here, so that
+ * a hit only has to evaluate it
  */
 int addBrk(int tmpFlag, int addr, char *expr)
 {
-  safeAddArray(brk_struct, brk_table, num_brk, size_brk);
-  brk_table[0].used = FALSE;
+  int brk = free_brk, errNo;
+  expr_code *code = NULL;
+  jmp_buf exprErr;
 
-  brk_table[num_brk].tmp = tmpFlag;
-  brk_table[num_brk].used = TRUE;
-  brk_table[num_brk].pc = addr;
-  brk_table[num_brk].op = memory[addr];
-  brk_table[num_brk].expr = expr;
-  return num_brk++;
+  if (expr)
+    {
+      setJmpBuf(&exprErr);
+      if ((errNo = setjmp(exprErr)) != 0)
+	{
+	  restoreJmpBuf();
+	  free(expr);
+	  longjmp(err, errNo);
+	}
+      code = compileExpr(expr);
+      restoreJmpBuf();
+    }
+
+  if (brk)
+    free_brk = brk_table[brk].next;
+  else
+    {
+      initBrks();
+      safeAddArray(brk_struct, brk_table, num_brk, size_brk);
+      brk = num_brk++;
+    }
+
+  brk_table[brk].tmp = tmpFlag;
+  brk_table[brk].used = TRUE;
+  brk_table[brk].pc = addr;
+  brk_table[brk].expr = expr;
+  brk_table[brk].code = code;
+  armBrk(addr);
+  return brk;
 }
 
 /* print break number. Print all if UNDEF, return TRUE if break exists
@@ -124,66 +274,291 @@ void delBrk(int brk)
       for (i = 1; i<num_brk; ++i) if (brk_table[i].used) delBrk(i);
       return;
     }
-  if (brk_table[brk].used)
+  if (brk_table && brk>=0 && brk<num_brk && brk_table[brk].used)
     {
       free(brk_table[brk].expr); /* free expr string, if any */
+      freeExpr(brk_table[brk].code);
       brk_table[brk].used = FALSE;
+      for (i = 0; i<num_brk; ++i) /* the address may have another break */
+	if (brk_table[i].used && brk_table[i].pc == brk_table[brk].pc) break;
+      if (i == num_brk) sim->brk_map[brk_table[brk].pc/BRK_BITS] &= ~brkBit(brk_table[brk].pc);
+      if (brk)
+	{
+	  brk_table[brk].next = free_brk;
+	  free_brk = brk;
+	}
     }
   else if (brk)
     printf("Warning: break #%d does not exist\n", brk);
 }
 
-/* stepone will execute one instruction. It will step over any break
+/* add a node for a call of addr from node parent to the call graph,
+ * if it is not there already. Returns its index
  */
-void stepOne(void)
+static int addCall(int parent, int addr)
 {
-  int oldPC = pc, brk = -memory[pc] - 1;
-  if (brk>=0) memory[pc] = brk_table[brk].op;
-  step();
-  if (brk>=0) memory[oldPC] = -brk - 1;
+  call_node *n;
+  int i;
+
+  for (i = (parent == UNDEF) ? UNDEF : call_nodes[parent].child; i != UNDEF; i = call_nodes[i].next)
+    {
+      if (call_nodes[i].addr == addr) return i;
+    }
+  safeAddArray(call_node, call_nodes, num_nodes, size_nodes);
+  n = call_nodes + num_nodes;
+  n->addr = addr;
+  n->parent = parent;
+  n->child = UNDEF;
+  n->next = (parent == UNDEF) ? UNDEF : call_nodes[parent].child;
+  n->calls = n->cycles = 0;
+  if (parent != UNDEF) call_nodes[parent].child = num_nodes;
+  return num_nodes++;
 }
 
-/* run will start executing at pc or the address given it until it 
- * encounters break. run will return the current pc at break
+/* follow the step of the instruction op at addr that took cycles on the
+ * shadow call stack. A call pushes a frame, a step to the return address
+ * of a frame pops it and the frames above it. Returns that go elsewhere,
+ * as a jump through an address pushed on the stack, are not calls
  */
-int run(int addr, int trace)
+static void traceCall(int addr, int op, unsigned long long cycles)
 {
-  char *expr;
-  int brk, brkFnd;
-  if (addr == UNDEF) longjmp(err, bad_addr);
+  call_frame *f;
 
-  if (!brk_table)
+  call_nodes[call_now].cycles += cycles;
+  if (isJSR(op) && num_frames<CALL_MAX)
     {
-      safeAddArray(brk_struct, brk_table, num_brk, size_brk);
-      brk_table[0].used = 0; brk_table[0].expr = 0;
+      f = call_stack + num_frames++;
+      f->node = call_now;
+      f->ret = addr + cpu_instr_tkn[op][INSTR_TKN_BYTES];
+      if (f->ret<MEMORY_MAX) ++ret_count[f->ret];
+      call_now = addCall(call_now, sim->pc);
+      ++call_nodes[call_now].calls;
     }
-  for (brk = 0; brk < num_brk; ++brk)
+  else if (ret_count[sim->pc])
     {
-      if (brk_table[brk].used)
+      do
 	{
-	  memory[brk_table[brk].pc] = -brk - 1;
+	  f = call_stack + --num_frames;
+	  if (f->ret<MEMORY_MAX) --ret_count[f->ret];
+	  call_now = f->node;
 	}
+      while (f->ret != sim->pc);
     }
+}
 
-  if (memory[pc]<0) stepOne();
+/* stepone will execute one instruction. Breaks are not in memory[], so
+ * there is nothing to step over. The record of the step is in the undo
+ * log before it runs, an error still leaves its changes to be undone.
+ * An interrupt an event requests is not, the log is cleared instead.
+ * sim->watch_hit is set, if it hits a watch
+ */
+void stepOne(void)
+{
+  undo_rec *r;
+  int addr = sim->pc, op = sim->memory[addr], gen = sim->irq_gen;
+  unsigned long long cycles = sim->cycles;
+
+  sim->watch_hit = 0;
+  syncEvents(sim); /* memory may have been changed since */
+  if (undo_size)
+    {
+      r = undo_log + undo_next;
+      if (++undo_next == undo_size) undo_next = 0;
+      if (undo_num<undo_size) ++undo_num;
+      logStep(sim, r);
+    }
+  else
+    step(sim);
+  syncEvents(sim);
+  if (sim->irq_gen != gen) clearUndo(); /* the irq of an event is not logged */
+
+  if (sim->cover) coverStep(sim, addr);
+  if (!profiling) return;
+  ++prof_count[addr];
+  prof_cycles[addr] += sim->cycles - cycles;
+  traceCall(addr, op, sim->cycles - cycles);
+}
+
+/* waitHalt will step the halt at pc once and then skip as many of the n
+ * steps left as it takes to get just before the next event, by adding
+ * their cycles and profile. Nothing is skipped while steps are logged
+ * or watched. Returns the number of steps executed
+ */
+unsigned long long waitHalt(unsigned long long n)
+{
+  int addr = sim->pc;
+  unsigned long long c = sim->cycles, times = 0;
+
+  stepOne();
+  if (sim->pc != addr || sim->watch_hit || sim->watching || undo_size) return 1;
+  c = sim->cycles - c;
+  if (c && sim->next_event != ULLONG_MAX && sim->next_event>sim->cycles)
+    times = (sim->next_event - sim->cycles - 1)/c;
+  if (times>n - 1) times = n - 1;
+  sim->cycles += times*c;
+  if (profiling)
+    {
+      prof_count[addr] += times;
+      prof_cycles[addr] += times*c;
+      call_nodes[call_now].cycles += times*c;
+    }
+  return times + 1;
+}
+
+/* keep the last size steps in the undo log, or turn it off with 0.
+ * The steps logged so far are dropped
+ */
+void setUndo(int size)
+{
+  free(undo_log);
+  undo_log = NULL;
+  undo_size = size;
+  undo_next = undo_num = 0;
+  if (size) safeCalloc(undo_log, undo_rec, size);
+}
+
+/* drop the steps logged so far, e.g. after a reset, which is not logged
+ */
+void clearUndo(void)
+{
+  undo_next = undo_num = 0;
+}
+
+/* start profiling with all counts cleared if flag is TRUE, otherwise
+ * stop it
+ */
+void setProfile(int flag)
+{
+  if (flag)
+    {
+      safeCalloc(prof_count, unsigned long long, MEMORY_MAX);
+      safeCalloc(prof_cycles, unsigned long long, MEMORY_MAX);
+      safeCalloc(ret_count, int, MEMORY_MAX);
+      num_nodes = num_frames = 0;
+      call_now = addCall(UNDEF, sim->pc);
+    }
+  profiling = flag;
+}
+
+/* return number of times the instruction at addr was executed while
+ * profiling and the cycles it took in *cycles
+ */
+unsigned long long getProfile(int addr, unsigned long long *cycles)
+{
+  *cycles = (prof_cycles) ? prof_cycles[addr] : 0;
+  return (prof_count) ? prof_count[addr] : 0;
+}
+
+/* return the nodes of the call graph of the profile and their number
+ * in *num. The first is where profiling was started
+ */
+const call_node *getCalls(int *num)
+{
+  *num = num_nodes;
+  return call_nodes;
+}
+
+/* undo the last step in the log. Returns FALSE if there is none
+ */
+int stepBack(void)
+{
+  if (!undo_num) return FALSE;
+  undo_next = (undo_next + undo_size - 1)%undo_size;
+  --undo_num;
+  undoStep(sim, undo_log + undo_next);
+  return TRUE;
+}
+
+/* undo steps until the first break is found, as run() does forward.
+ * Returns its address or UNDEF, if the start of the log is reached
+ */
+int runBack(void)
+{
+  expr_code *code;
+  int brk;
+
+  while (stepBack())
+    {
+      brk = findBrk(sim->pc);
+      if (brk<0 || ((code = brk_table[brk].code) && !evalExpr(code))) continue;
+      if (brk_table[brk].tmp) delBrk(brk);
+      return sim->pc;
+    }
+  return UNDEF;
+}
+
+/* run will start executing at pc or the address given it until it 
+ * encounters break or hits a watch. run will return the current pc at
+ * break, sim->watch_hit is set for a watch
+ */
+int run(int addr, int trace)
+{
+  expr_code *code;
+  int brkFnd = UNDEF;
+  if (addr == UNDEF) longjmp(err, bad_addr);
+
+  sim->watch_hit = 0;
+  if (isBrk(sim, sim->pc)) stepOne();
   if (trace) traceDisplay();
-  while (TRUE)
+  while (!sim->watch_hit)
     {
-      brkFnd = -memory[pc] - 1;
-      if ((brkFnd>=0) && (!(expr = brk_table[brkFnd].expr) || getExpr(expr))) break;
+      /* without trace, let the cpu run on its own until it hits a break
+       */
+      if (!trace && !stepOnly()) 
+	while (!runBlocks(sim, EXEC_BUDGET, ULLONG_MAX) && !sim->watch_hit);
+      if (sim->watch_hit) break;
+      brkFnd = findBrk(sim->pc);
+      if ((brkFnd>=0) && (!(code = brk_table[brkFnd].code) || evalExpr(code))) break;
       stepOne();
       if (trace) traceDisplay();
     }
 
-  for (brk = 0; brk < num_brk; ++brk)
+  delBrk(0);
+  if (sim->watch_hit) return sim->pc;
+  if (brk_table[brkFnd].tmp) delBrk(brkFnd);
+  return brk_table[brkFnd].pc;
+}
+
+/* runFor will execute n instructions at pc, or n cycles if cycleFlag is
+ * set, without tracing or display. Stops early at a break or watch like
+ * run(). *instrs is set to the number of executed instructions. Returns
+ * pc of the break found or UNDEF, if all of n has been executed
+ */
+int runFor(unsigned long long n, int cycleFlag, unsigned long long *instrs)
+{
+  expr_code *code;
+  int brk, count, brkFnd = UNDEF;
+  unsigned long long limit = (cycleFlag) ? sim->cycles + n : ULLONG_MAX;
+
+  *instrs = 0;
+  sim->watch_hit = 0;
+  if (n && isBrk(sim, sim->pc))
     {
-      if (brk_table[brk].used)
+      stepOne();
+      ++*instrs;
+    }
+  while (!sim->watch_hit && ((cycleFlag) ? sim->cycles<limit : *instrs<n))
+    {
+      brk = findBrk(sim->pc);
+      if (brk<0 && !stepOnly())
+	{
+	  count = (cycleFlag || n - *instrs>EXEC_BUDGET) ? EXEC_BUDGET : n - *instrs;
+	  *instrs += count - runBlocks(sim, count, limit);
+	}
+      else if (brk>=0 && (!(code = brk_table[brk].code) || evalExpr(code)))
+	{
+	  brkFnd = brk;
+	  break;
+	}
+      else
 	{
-	  memory[brk_table[brk].pc] = brk_table[brk].op;
+	  stepOne();
+	  ++*instrs;
 	}
     }
 
-  brk_table[0].used = FALSE;
+  if (sim->watch_hit) return sim->pc;
+  if (brkFnd == UNDEF) return UNDEF;
   if (brk_table[brkFnd].tmp) delBrk(brkFnd);
   return brk_table[brkFnd].pc;
 }
@@ -193,7 +568,7 @@ int run(int addr, int trace)
  */
 int next()
 {
-  if (isJSR(memory[pc])) addBrk(TRUE, pc, NULL);
+  if (isJSR(sim->memory[sim->pc])) addBrk(TRUE, sim->pc, NULL);
   return run(UNDEF, FALSE);
 }
 
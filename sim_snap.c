@@ -0,0 +1,124 @@
+/*************************************************************************************
+
+    Copyright (c) 2003 - 2005 by James L. Terman
+    This file is part of the Simulator
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ *************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#define SNAP_LOCAL
+
+#include "asmdefs.h"
+#include "cpu.h"
+#include "err.h"
+#include "ctx.h"
+#include "snap.h"
+
+void initSnap(snap_header *head, sim_ctx *s, const char *cpu, int size, int flags)
+{
+  memset(head, 0, sizeof(snap_header));
+  memcpy(head->magic, SNAP_MAGIC, sizeof(head->magic));
+  head->version = SNAP_VERSION;
+  head->size = size;
+  strncpy(head->cpu, cpu, sizeof(head->cpu));
+  head->flags = flags;
+  head->pc_addr = s->pc;
+  head->cycles = s->cycles;
+}
+
+/* only system calls are used, the simulator writes its core from the
+ * signal handler
+ */
+int writeSnap(int fd, const struct iovec *iov, int num)
+{
+  ssize_t len = 0;
+  int i;
+
+  for (i = 0; i<num; ++i) len += iov[i].iov_len;
+  return writev(fd, iov, num) == len;
+}
+
+snap_header *mapSnap(int fd, const char *cpu, size_t *len, int write)
+{
+  struct stat st;
+  snap_header *head;
+
+  if (fstat(fd, &st) || st.st_size<sizeof(snap_header)) return NULL;
+  head = mmap(NULL, st.st_size, write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+  if (head == MAP_FAILED) return NULL;
+  if (memcmp(head->magic, SNAP_MAGIC, sizeof(head->magic)) || 
+      head->version != SNAP_VERSION || head->size>st.st_size ||
+      strncmp(head->cpu, cpu, sizeof(head->cpu)))
+    {
+      munmap(head, st.st_size);
+      return NULL;
+    }
+  *len = st.st_size;
+  return head;
+}
+
+void unmapSnap(const void *head, size_t len)
+{
+  munmap((void*) head, len);
+}
+
+int isSnap(int fd)
+{
+  char magic[sizeof(SNAP_MAGIC) - 1];
+
+  return pread(fd, magic, sizeof(magic), 0) == sizeof(magic) && 
+    !memcmp(magic, SNAP_MAGIC, sizeof(magic));
+}
+
+/* the snapshot is in an unnamed temporary file, it is removed when the
+ * state and all machines forked from it are freed
+ */
+struct sim_state
+{
+  FILE *file;
+};
+
+sim_state *saveState(sim_ctx *s)
+{
+  sim_state *state = NULL;
+
+  safeMalloc(state, sim_state, 1);
+  if (!(state->file = tmpfile()) || !saveSnap(s, fileno(state->file), TRUE))
+    {
+      if (state->file) fclose(state->file);
+      free(state);
+      return NULL;
+    }
+  return state;
+}
+
+sim_ctx *forkState(const sim_state *state)
+{
+  return mapSim(fileno(state->file));
+}
+
+void freeState(sim_state *state)
+{
+  fclose(state->file);
+  free(state);
+}
@@ -0,0 +1,151 @@
+/*************************************************************************************
+
+    Copyright (c) 2003 - 2005 by James L. Terman
+    This file is part of the Simulator
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ *************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#define WATCH_LOCAL
+
+#include "asmdefs.h"
+#include "cpu.h"
+#include "err.h"
+#include "ctx.h"
+#include "block.h"
+#include "watch.h"
+
+static watch_struct *watches = NULL;
+static int num_watch = 0;
+static int size_watch = 0;
+static int free_watch = 0; /* number of first free entry, 0 if none */
+
+static watch_event event; /* access of last hit */
+
+/* the first watch hit by an instruction stops it, later accesses are
+ * not looked at until the hit is cleared
+ */
+void watchByte(sim_ctx *s, int area, int index, int kind, int old, int value)
+{
+  const watch_struct *w;
+  int n, hit;
+
+  if (s->watch_hit) return;
+  for (n = 0; n<num_watch; ++n)
+    {
+      w = watches + n;
+      if (!w->used || w->area != area || index<w->first || index>w->last) continue;
+      hit = w->kind & kind;
+      if (kind == WATCH_WRITE && (w->kind & WATCH_CHANGE) && ((old ^ value) & w->bit)) 
+	hit = WATCH_CHANGE;
+      if (!hit) continue;
+
+      s->watch_hit = n + 1;
+      event.kind = hit;
+      event.addr = w->addr + index - w->first;
+      event.old = old;
+      event.value = value;
+      return;
+    }
+}
+
+/* mark the pages of area that have a watch with the kind of access
+ * the backend has to check, a change is only seen by a write
+ */
+static void markWatch(sim_ctx *s, int area)
+{
+  const watch_struct *w;
+  int n, page, kind;
+
+  memset(s->watch_map[area], 0, sizeof(s->watch_map[area]));
+  for (n = 0; n<num_watch; ++n)
+    {
+      w = watches + n;
+      if (!w->used || w->area != area) continue;
+      kind = (w->kind & WATCH_READ) | ((w->kind & (WATCH_WRITE | WATCH_CHANGE)) ? WATCH_WRITE : 0);
+      for (page = w->first/WATCH_PAGE; page<=w->last/WATCH_PAGE; ++page) 
+	s->watch_map[area][page] |= kind;
+    }
+}
+
+/* the range has to be of consecutive bytes of an area. A bit is
+ * watched on its own
+ */
+int addWatch(sim_ctx *s, char m, int addr, int len, int kind)
+{
+  watch_struct *w;
+  int n = free_watch, area, first, last, bit, b;
+
+  if (len<1) longjmp(err, out_range);
+  if ((area = watchArea(s, addr, m, &first, &bit)) == UNDEF) longjmp(err, bad_addr);
+  if (watchArea(s, addr + len - 1, m, &last, &b) != area) longjmp(err, bad_addr);
+  if ((bit != BYTE_MASK) ? len>1 : last - first != len - 1) longjmp(err, out_range);
+
+  if (n)
+    free_watch = watches[n - 1].next;
+  else
+    {
+      safeAddArray(watch_struct, watches, num_watch, size_watch);
+      n = ++num_watch;
+    }
+  w = watches + n - 1;
+  w->used = TRUE;
+  w->kind = kind;
+  w->m = m;
+  w->addr = addr;
+  w->len = len;
+  w->area = area;
+  w->first = first;
+  w->last = last;
+  w->bit = bit;
+  if (!s->watching++) flushBlocks(s); /* blocks are decoded for watches */
+  markWatch(s, area);
+  return n;
+}
+
+int delWatch(sim_ctx *s, int n)
+{
+  watch_struct *w;
+
+  if (n == UNDEF)
+    {
+      for (n = 1; n<=num_watch; ++n) if (watches[n - 1].used) delWatch(s, n);
+      return TRUE;
+    }
+  if (n<1 || n>num_watch || !watches[n - 1].used) return FALSE;
+  w = watches + n - 1;
+  w->used = FALSE;
+  w->next = free_watch;
+  free_watch = n;
+  if (!--s->watching) flushBlocks(s);
+  markWatch(s, w->area);
+  return TRUE;
+}
+
+const watch_struct *getWatches(int *num)
+{
+  *num = num_watch;
+  return watches;
+}
+
+const watch_event *getWatchEvent(void)
+{
+  return &event;
+}